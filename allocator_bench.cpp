@@ -0,0 +1,930 @@
+// Copyright Howard Hinnant. Distributed under the Boost
+// Software License, Version 1.0. (see http://www.boost.org/LICENSE_1_0.txt)
+
+// Allocator benchmark suite.
+//
+// Runs std::vector, std::basic_string, std::list, std::map,
+// std::unordered_map and std::deque workloads (fill, erase churn, copy and
+// strings short enough for the small string optimization) with
+//
+//   std::allocator
+//   short_alloc with 1 KiB, 16 KiB and 256 KiB arenas
+//   stack_alloc
+//   std::pmr::monotonic_buffer_resource over a 16 KiB buffer (C++17)
+//
+// Every workload builds its containers from scratch, and the arena or
+// buffer is reset between repetitions, as it would be per request.
+// Reported per configuration:
+//
+//   ns/op     time per element operation
+//   heap      allocations per repetition that reached the global operator
+//             new (replaced in this program to count them)
+//   peak      high-water mark in bytes of the short_alloc arena, the
+//             stack_alloc storage or the memory handed out by the
+//             monotonic_buffer_resource, else "-"
+//   misses    hardware cache misses per repetition, where perf_event_open
+//             is available (Linux), else "-"
+//
+// A second phase times containers of 4 to 32 elements that are built,
+// copied, moved and destroyed: small_vector, small_string and
+// small_flat_map against the std containers with std::allocator and with
+// short_alloc over an arena declared beside the container.  Reported are
+// ns and heap allocations per container.
+//
+// Before any timing, the program checks that stack_alloc never reaches
+// the heap for emplace_back into reserved space or for move assignment,
+// that it aligns over-aligned types, that the fill forms of small_string
+// write the fill character, that a growing_arena reused per request stops
+// growing its blocks, and that arena_pool_resource frees, rather than
+// pools, the blocks its arena spilled to the heap.  Any failure aborts.  Build with -fsanitize=address to have leaks reported
+// as well.
+//
+//   c++ -std=c++17 -O2 allocator_bench.cpp
+//   ./a.out [repetitions]
+
+#include "short_alloc.h"
+#include "stack_alloc.h"
+#include "small_containers.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <list>
+#include <map>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__has_include)
+#  if __has_include(<memory_resource>) && __cplusplus >= 201703L
+#    define BENCH_PMR 1
+#    include <memory_resource>
+#    include "arena_resource.h"
+#  endif
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+std::atomic<std::size_t> heap_allocations(0);
+std::atomic<std::size_t> heap_frees(0);
+
+}  // unnamed namespace
+
+// GCC takes the malloc/free pairing below for a mismatched new/delete
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+// and cannot see that stack_storage only frees blocks outside its buffer
+#pragma GCC diagnostic ignored "-Wfree-nonheap-object"
+#endif
+
+void*
+operator new(std::size_t n)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n == 0 ? 1 : n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept
+{
+    if (p != nullptr)
+        heap_frees.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {operator delete(p);}
+
+#ifdef __cpp_aligned_new
+
+// Reached by std::pmr::new_delete_resource()
+
+void*
+operator new(std::size_t n, std::align_val_t a)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(a);
+    if (void* p = std::aligned_alloc(align, (n + align - 1) / align * align))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {operator delete(p);}
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+    {operator delete(p);}
+
+#endif  // __cpp_aligned_new
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+volatile std::size_t sink;  // keeps results alive
+
+void
+check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "check failed: %s\n", what);
+        std::abort();
+    }
+}
+
+// Counts how its objects come to be, to tell in-place construction from
+// a construct-then-copy
+
+struct emplaced
+{
+    static int copies;
+    int a_;
+    double b_;
+
+    emplaced(int a, double b) : a_(a), b_(b) {}
+    emplaced(const emplaced& e) : a_(e.a_), b_(e.b_) {++copies;}
+    emplaced(emplaced&& e) noexcept : a_(e.a_), b_(e.b_) {++copies;}
+};
+
+int emplaced::copies = 0;
+
+struct alignas(64) overaligned
+{
+    char c_[64];
+};
+
+void
+check_stack_alloc()
+{
+    std::size_t heap0 = heap_allocations.load();
+    std::size_t frees0 = heap_frees.load();
+    {
+        // emplace_back into reserved storage
+        typedef stack_alloc<emplaced, 64> A;
+        A::storage_type s;
+        std::vector<emplaced, A> v(s);
+        v.reserve(64);
+        for (int i = 0; i < 64; ++i)
+            v.emplace_back(i, 0.5);
+        check(emplaced::copies == 0, "stack_alloc: emplace_back copied");
+        check(s.owns(v.data()), "stack_alloc: vector is not in its storage");
+    }
+    {
+        // Move assignment takes the source's buffer along with its elements
+        typedef stack_alloc<int, 256> A;
+        A::storage_type s1;
+        A::storage_type s2;
+        std::vector<int, A> v(s1);
+        std::vector<int, A> w(s2);
+        v.reserve(256);
+        for (int i = 0; i < 256; ++i)
+            v.push_back(i);
+        w.reserve(16);
+        const int* data = v.data();
+        w = std::move(v);
+        check(w.data() == data, "stack_alloc: move assignment copied");
+        check(w.get_allocator() == A(s1),
+              "stack_alloc: move assignment did not propagate");
+    }
+    {
+        typedef stack_alloc<int, 256> A;
+        A::storage_type s1;
+        A::storage_type s2;
+        std::list<int, A> l1(s1);
+        std::list<int, A> l2(s2);
+        l1.assign(16, 1);
+        l2.assign(4, 2);
+        l2 = std::move(l1);
+        check(l2.size() == 16 && s1.owns(&l2.front()),
+              "stack_alloc: list move assignment copied");
+    }
+    check(heap_allocations.load() == heap0, "stack_alloc: reached the heap");
+    {
+        // Over-aligned elements, beyond the first after a smaller one
+        typedef stack_alloc<overaligned, 4> A;
+        A::storage_type s;
+        std::vector<char, A::rebind<char>::other> c(s);
+        c.push_back('x');
+        std::vector<overaligned, A> v(s);
+        v.reserve(2);
+        check(reinterpret_cast<std::uintptr_t>(v.data()) % 64 == 0,
+              "stack_alloc: over-aligned element misplaced");
+    }
+    {
+        // allocate(0) on a full buffer hands out the end of the buffer
+        stack_storage<64> s;
+        void* p = s.allocate(64, 1);
+        void* q = s.allocate(0, 1);
+        s.deallocate(q, 0, 1);
+        s.deallocate(p, 64, 1);
+        check(s.used() == 0, "stack_storage: zero-size block");
+    }
+    check(heap_frees.load() == frees0, "stack_alloc: freed stack memory");
+    std::printf("stack_alloc: emplace_back and move assignment stay off the "
+                "heap\n");
+}
+
+#if BENCH_PMR
+
+std::size_t
+heap_live()
+{
+    return heap_allocations.load() - heap_frees.load();
+}
+
+// Overflows a stack_pool_resource with list nodes, churns them through the
+// free lists, and destroys the list.  Every node that went to the heap
+// must have been given back.
+
+void
+check_pool_overflow()
+{
+    std::size_t live0 = heap_live();
+    std::size_t spilled;
+    {
+        stack_pool_resource<256> r;
+        std::pmr::list<int> l(&r);
+        std::size_t heap0 = heap_allocations.load();
+        for (int i = 0; i < 100; ++i)
+            l.push_back(i);
+        for (int i = 0; i < 50; ++i)
+            l.pop_front();
+        for (int i = 0; i < 50; ++i)
+            l.push_back(i);
+        spilled = heap_allocations.load() - heap0;
+    }
+    std::size_t leaked = heap_live() - live0;
+    std::printf("arena_pool_resource overflow: %zu heap blocks, %zu leaked\n",
+                spilled, leaked);
+    check(spilled > 0, "arena_pool_resource did not overflow its arena");
+    check(leaked == 0, "arena_pool_resource leaked heap blocks");
+}
+
+#endif  // BENCH_PMR
+
+// An Upstream for growing_arena that records the size of every block it
+// hands out
+
+struct logging_upstream
+{
+    std::vector<std::size_t>* sizes_;
+
+    void*
+    allocate(std::size_t n, std::size_t align)
+    {
+        sizes_->push_back(n);
+        return new_delete_upstream().allocate(n, align);
+    }
+    void
+    deallocate(void* p, std::size_t n, std::size_t align) noexcept
+    {
+        new_delete_upstream().deallocate(p, n, align);
+    }
+};
+
+// A growing_arena reset after every request of the same size must settle
+// on the same blocks for each, rather than double its block size forever
+
+void
+check_growing_arena()
+{
+    std::vector<std::size_t> sizes;
+    growing_arena<256, alignof(std::max_align_t), logging_upstream>
+        a(logging_upstream{&sizes});
+    std::vector<std::size_t> first;
+    std::vector<std::size_t> last;
+    for (int request = 0; request < 8; ++request)
+    {
+        sizes.clear();
+        for (int i = 0; i < 20; ++i)  // 2000 bytes, 1744 of them overflow
+            a.allocate<alignof(std::max_align_t)>(100);
+        if (request == 1)
+            first = sizes;
+        last = sizes;
+        a.reset();
+    }
+    check(first.size() == 1, "growing_arena: more than one block per request");
+    check(last == first, "growing_arena: block size kept growing");
+    std::printf("growing_arena: reused per request, settles on one %zu byte "
+                "block\n", first[0]);
+}
+
+// The fill forms of small_string: (n, c), append(n, c) and resize(n, c),
+// inline and past the inline buffer
+
+void
+check_small_string()
+{
+    typedef small_string<8> S;
+    S s(3, 'x');
+    check(s.size() == 3 && s == "xxx", "small_string: (n, c)");
+    S t("ab");
+    t.append(2, 'y');
+    check(t.size() == 4 && t == "abyy", "small_string: append(n, c)");
+    t.append(10, 'z');
+    check(t.size() == 14 && t == "abyyzzzzzzzzzz",
+          "small_string: append(n, c) past the inline buffer");
+    check(t.c_str()[14] == '\0', "small_string: append(n, c) terminator");
+    S u("a");
+    u.resize(4, 'w');
+    check(u.size() == 4 && u == "awww", "small_string: resize(n, c)");
+    u.resize(2);
+    check(u.size() == 2 && u == "aw" && u.c_str()[2] == '\0',
+          "small_string: resize shrinking");
+    u.resize(12, 'v');
+    check(u.size() == 12 && u == "awvvvvvvvvvv",
+          "small_string: resize(n, c) past the inline buffer");
+    S e(0, 'x');
+    e.append(0, 'y');
+    check(e.empty() && e == "", "small_string: empty fill");
+    std::printf("small_string: fills hold the fill character\n");
+}
+
+// Hardware cache miss counter for the calling thread
+
+class cache_misses
+{
+    int fd_;
+
+public:
+    cache_misses()
+        : fd_(-1)
+    {
+#ifdef __linux__
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd_ = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~cache_misses()
+    {
+#ifdef __linux__
+        if (fd_ >= 0)
+            close(fd_);
+#endif
+    }
+    cache_misses(const cache_misses&) = delete;
+    cache_misses& operator=(const cache_misses&) = delete;
+
+    bool available() const {return fd_ >= 0;}
+
+    void
+    start()
+    {
+#ifdef __linux__
+        if (fd_ >= 0)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long
+    stop()
+    {
+        long long n = 0;
+#ifdef __linux__
+        if (fd_ >= 0)
+        {
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd_, &n, sizeof(n)) != sizeof(n))
+                n = 0;
+        }
+#endif
+        return n;
+    }
+};
+
+// arena that remembers its high-water mark
+
+template <std::size_t N>
+class tracked_arena
+    : public arena<N>
+{
+    std::size_t peak_ = 0;
+
+public:
+    template <std::size_t ReqAlign>
+    char*
+    allocate(std::size_t n)
+    {
+        char* r = arena<N>::template allocate<ReqAlign>(n);
+        if (this->used() > peak_)
+            peak_ = this->used();
+        return r;
+    }
+
+    void reset() noexcept {arena<N>::reset(); peak_ = 0;}
+    std::size_t peak() const noexcept {return peak_;}
+};
+
+// stack_storage that remembers its high-water mark
+
+template <std::size_t Size>
+class tracked_storage
+    : public stack_storage<Size>
+{
+    std::size_t peak_ = 0;
+
+public:
+    void*
+    allocate(std::size_t n, std::size_t align)
+    {
+        void* r = stack_storage<Size>::allocate(n, align);
+        if (this->used() > peak_)
+            peak_ = this->used();
+        return r;
+    }
+
+    void reset() noexcept {stack_storage<Size>::reset(); peak_ = 0;}
+    std::size_t peak() const noexcept {return peak_;}
+};
+
+#if BENCH_PMR
+
+// Forwards to another memory_resource and counts the bytes handed out.
+// In front of a monotonic_buffer_resource, which gives nothing back
+// before release(), the count is its high-water mark.
+
+class counting_resource
+    : public std::pmr::memory_resource
+{
+    std::pmr::memory_resource* r_;
+    std::size_t bytes_ = 0;
+
+public:
+    explicit counting_resource(std::pmr::memory_resource* r) : r_(r) {}
+
+    void reset() noexcept {bytes_ = 0;}
+    std::size_t bytes() const noexcept {return bytes_;}
+
+private:
+    void*
+    do_allocate(std::size_t n, std::size_t align) override
+    {
+        void* p = r_->allocate(n, align);
+        bytes_ += n;
+        return p;
+    }
+
+    void
+    do_deallocate(void* p, std::size_t n, std::size_t align) override
+    {
+        r_->deallocate(p, n, align);
+    }
+
+    bool
+    do_is_equal(const std::pmr::memory_resource& r) const noexcept override
+    {
+        return this == &r;
+    }
+};
+
+#endif  // BENCH_PMR
+
+// Allocator configurations.  Each one hands out allocators for any value
+// type and is reset between repetitions.  has_peak is false when there is
+// no arena to measure.
+
+struct std_config
+{
+    template <class T> using alloc = std::allocator<T>;
+    static const bool has_peak = false;
+
+    const char* name() const {return "std::allocator";}
+    template <class T> alloc<T> get() {return alloc<T>();}
+    void reset() {}
+    std::size_t peak() const {return 0;}
+};
+
+template <std::size_t N>
+struct short_config
+{
+    template <class T>
+        using alloc = short_alloc<T, N, alignof(std::max_align_t),
+                                  tracked_arena<N>>;
+    static const bool has_peak = true;
+
+    tracked_arena<N> a_;
+    char name_[32];
+
+    short_config() {std::snprintf(name_, sizeof(name_), "short_alloc<%zu>", N);}
+    const char* name() const {return name_;}
+    template <class T> alloc<T> get() {return alloc<T>(a_);}
+    void reset() {a_.reset();}
+    std::size_t peak() const {return a_.peak();}
+};
+
+template <std::size_t N>
+struct stack_config
+{
+    typedef tracked_storage<N * sizeof(int)> storage_type;
+    template <class T> using alloc = stack_alloc<T, N, storage_type>;
+    static const bool has_peak = true;
+
+    storage_type s_;
+    char name_[32];
+
+    stack_config() {std::snprintf(name_, sizeof(name_), "stack_alloc<int, %zu>", N);}
+    const char* name() const {return name_;}
+    template <class T> alloc<T> get() {return alloc<T>(s_);}
+    void reset() {s_.reset();}
+    std::size_t peak() const {return s_.peak();}
+};
+
+#if BENCH_PMR
+
+struct pmr_config
+{
+    template <class T> using alloc = std::pmr::polymorphic_allocator<T>;
+    static const bool has_peak = true;
+
+    alignas(std::max_align_t) char buf_[16 * 1024];
+    std::pmr::monotonic_buffer_resource r_;
+    counting_resource c_;
+
+    pmr_config() : r_(buf_, sizeof(buf_)), c_(&r_) {}
+    const char* name() const {return "pmr::monotonic_buffer";}
+    template <class T> alloc<T> get() {return alloc<T>(&c_);}
+    void reset() {r_.release(); c_.reset();}
+    std::size_t peak() const {return c_.bytes();}
+};
+
+#endif  // BENCH_PMR
+
+// Workloads.  Each returns the number of element operations it performed.
+
+template <class C>
+std::size_t
+vector_fill(C& c)
+{
+    std::vector<int, typename C::template alloc<int>> v(c.template get<int>());
+    for (int i = 0; i < 1000; ++i)
+        v.push_back(i);
+    return 1000;
+}
+
+template <class C>
+std::size_t
+vector_copy(C& c)
+{
+    typedef std::vector<int, typename C::template alloc<int>> V;
+    V v(c.template get<int>());
+    v.reserve(500);
+    for (int i = 0; i < 500; ++i)
+        v.push_back(i);
+    V w(v);
+    return 500 + w.size();
+}
+
+template <class C>
+std::size_t
+string_short(C& c)
+{
+    typedef std::basic_string<char, std::char_traits<char>,
+                              typename C::template alloc<char>> S;
+    for (int i = 0; i < 100; ++i)
+    {
+        S s("short", c.template get<char>());
+        s += 'x';
+        sink = sink + s.size();
+    }
+    return 100;
+}
+
+template <class C>
+std::size_t
+string_append(C& c)
+{
+    typedef std::basic_string<char, std::char_traits<char>,
+                              typename C::template alloc<char>> S;
+    S s(c.template get<char>());
+    for (int i = 0; i < 500; ++i)
+        s += static_cast<char>('a' + i % 26);
+    S t(s);
+    return 500 + t.size();
+}
+
+template <class C>
+std::size_t
+list_churn(C& c)
+{
+    std::list<int, typename C::template alloc<int>> l(c.template get<int>());
+    for (int i = 0; i < 256; ++i)
+        l.push_back(i);
+    for (int i = 0; i < 1000; ++i)
+    {
+        l.pop_front();
+        l.push_back(i);
+    }
+    return 256 + 1000;
+}
+
+template <class C>
+std::size_t
+map_churn(C& c)
+{
+    typedef std::pair<const int, int> value_type;
+    std::map<int, int, std::less<int>, typename C::template alloc<value_type>>
+        m(std::less<int>(), c.template get<value_type>());
+    for (int i = 0; i < 256; ++i)
+        m.emplace(i, i);
+    for (int i = 0; i < 1000; ++i)
+    {
+        m.erase(i);
+        m.emplace(i + 256, i);
+    }
+    return 256 + 1000;
+}
+
+template <class C>
+std::size_t
+unordered_fill(C& c)
+{
+    typedef std::pair<const int, int> value_type;
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                       typename C::template alloc<value_type>>
+        m(0, std::hash<int>(), std::equal_to<int>(),
+          c.template get<value_type>());
+    for (int i = 0; i < 512; ++i)
+        m.emplace(i, i);
+    return 512;
+}
+
+template <class C>
+std::size_t
+deque_churn(C& c)
+{
+    std::deque<int, typename C::template alloc<int>> d(c.template get<int>());
+    for (int i = 0; i < 1000; ++i)
+        d.push_back(i);
+    while (!d.empty())
+        d.pop_front();
+    return 2000;
+}
+
+template <class C, class Workload>
+void
+run(const char* workload, C& c, Workload w, std::size_t reps, cache_misses& cm)
+{
+    std::size_t ops = 0;
+    std::size_t peak = 0;
+    std::size_t heap0 = heap_allocations.load();
+    cm.start();
+    Clock::time_point t0 = Clock::now();
+    for (std::size_t r = 0; r < reps; ++r)
+    {
+        ops += w(c);
+        if (c.peak() > peak)
+            peak = c.peak();
+        c.reset();
+    }
+    Clock::time_point t1 = Clock::now();
+    long long misses = cm.stop();
+    std::size_t heap = heap_allocations.load() - heap0;
+    std::printf("%-16s %-24s %8.2f %8.1f", workload, c.name(),
+                std::chrono::duration<double, std::nano>(t1 - t0).count() / ops,
+                static_cast<double>(heap) / reps);
+    if (C::has_peak)
+        std::printf(" %8zu", peak);
+    else
+        std::printf(" %8s", "-");
+    if (cm.available())
+        std::printf(" %10.1f\n", static_cast<double>(misses) / reps);
+    else
+        std::printf(" %10s\n", "-");
+}
+
+template <class C>
+void
+run_all(C& c, std::size_t reps, cache_misses& cm)
+{
+    run("vector fill", c, vector_fill<C>, reps, cm);
+    run("vector copy", c, vector_copy<C>, reps, cm);
+    run("string short", c, string_short<C>, reps, cm);
+    run("string append", c, string_append<C>, reps, cm);
+    run("list churn", c, list_churn<C>, reps, cm);
+    run("map churn", c, map_churn<C>, reps, cm);
+    run("unordered fill", c, unordered_fill<C>, reps, cm);
+    run("deque churn", c, deque_churn<C>, reps, cm);
+}
+
+// Small containers.  Each workload builds a container of n elements,
+// copies it, moves the copy and returns a checksum.
+
+const std::size_t small_arena_size = 1024;
+
+template <class T>
+    using small_arena_alloc = short_alloc<T, small_arena_size>;
+
+template <class V>
+std::size_t
+vector_small(V v, int n)
+{
+    for (int i = 0; i < n; ++i)
+        v.push_back(i);
+    V w(v);
+    V x(std::move(w));
+    return v.size() + static_cast<std::size_t>(x.back());
+}
+
+template <class S>
+std::size_t
+string_small(S s, int n)
+{
+    for (int i = 0; i < n; ++i)
+        s += static_cast<char>('a' + i);
+    S t(s);
+    S u(std::move(t));
+    return s.size() + static_cast<std::size_t>(u.back());
+}
+
+template <class M>
+std::size_t
+map_small(M m, int n)
+{
+    for (int i = 0; i < n; ++i)
+        m[(i * 7) % n] = i;
+    M c(m);
+    M d(std::move(c));
+    std::size_t r = 0;
+    for (int i = 0; i < n; ++i)
+        r += static_cast<std::size_t>(d.find(i)->second);
+    return r;
+}
+
+struct std_vector_t
+{
+    const char* name() const {return "std::vector";}
+    std::size_t operator()(int n) const {return vector_small(std::vector<int>(), n);}
+};
+
+struct short_vector_t
+{
+    const char* name() const {return "std::vector + short_alloc";}
+    std::size_t
+    operator()(int n) const
+    {
+        arena<small_arena_size> a;
+        typedef std::vector<int, small_arena_alloc<int>> V;
+        return vector_small(V(small_arena_alloc<int>(a)), n);
+    }
+};
+
+struct small_vector_t
+{
+    const char* name() const {return "small_vector<int, 32>";}
+    std::size_t operator()(int n) const {return vector_small(small_vector<int, 32>(), n);}
+};
+
+struct std_string_t
+{
+    const char* name() const {return "std::string";}
+    std::size_t operator()(int n) const {return string_small(std::string(), n);}
+};
+
+struct short_string_t
+{
+    const char* name() const {return "std::string + short_alloc";}
+    std::size_t
+    operator()(int n) const
+    {
+        arena<small_arena_size> a;
+        typedef std::basic_string<char, std::char_traits<char>,
+                                  small_arena_alloc<char>> S;
+        return string_small(S(small_arena_alloc<char>(a)), n);
+    }
+};
+
+struct small_string_t
+{
+    const char* name() const {return "small_string<32>";}
+    std::size_t operator()(int n) const {return string_small(small_string<32>(), n);}
+};
+
+struct std_map_t
+{
+    const char* name() const {return "std::map";}
+    std::size_t operator()(int n) const {return map_small(std::map<int, int>(), n);}
+};
+
+struct short_map_t
+{
+    const char* name() const {return "std::map + short_alloc";}
+    std::size_t
+    operator()(int n) const
+    {
+        typedef std::pair<const int, int> value_type;
+        arena<small_arena_size * 4> a;
+        typedef short_alloc<value_type, small_arena_size * 4> A;
+        typedef std::map<int, int, std::less<int>, A> M;
+        return map_small(M(std::less<int>(), A(a)), n);
+    }
+};
+
+struct small_flat_map_t
+{
+    const char* name() const {return "small_flat_map<32>";}
+    std::size_t
+    operator()(int n) const
+    {
+        return map_small(small_flat_map<int, int, 32>(), n);
+    }
+};
+
+template <class Workload>
+void
+run_small(const char* workload, Workload w, std::size_t reps)
+{
+    for (int n = 4; n <= 32; n *= 2)
+    {
+        std::size_t heap0 = heap_allocations.load();
+        std::size_t r = 0;
+        Clock::time_point t0 = Clock::now();
+        for (std::size_t i = 0; i < reps; ++i)
+            r += w(n);
+        Clock::time_point t1 = Clock::now();
+        sink = r;
+        std::size_t heap = heap_allocations.load() - heap0;
+        std::printf("%-16s %-28s %4d %8.1f %8.2f\n", workload, w.name(), n,
+                    std::chrono::duration<double, std::nano>(t1 - t0).count() / reps,
+                    static_cast<double>(heap) / reps);
+    }
+}
+
+}  // unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::size_t reps = 2000;
+    if (argc > 1)
+        reps = std::strtoul(argv[1], nullptr, 10);
+    check_stack_alloc();
+    check_small_string();
+    check_growing_arena();
+#if BENCH_PMR
+    check_pool_overflow();
+#endif
+    std::printf("\n");
+    cache_misses cm;
+    std::printf("%-16s %-24s %8s %8s %8s %10s\n", "workload", "allocator",
+                "ns/op", "heap", "peak", "misses");
+    {
+        std_config c;
+        run_all(c, reps, cm);
+    }
+    {
+        static short_config<1024> c;
+        run_all(c, reps, cm);
+    }
+    {
+        static short_config<16 * 1024> c;
+        run_all(c, reps, cm);
+    }
+    {
+        static short_config<256 * 1024> c;
+        run_all(c, reps, cm);
+    }
+    {
+        static stack_config<4096> c;
+        run_all(c, reps, cm);
+    }
+#if BENCH_PMR
+    {
+        static pmr_config c;
+        run_all(c, reps, cm);
+    }
+#endif
+    std::printf("\n%-16s %-28s %4s %8s %8s\n", "workload", "container", "n",
+                "ns", "heap");
+    std::size_t small_reps = reps * 50;
+    run_small("small vector", std_vector_t(), small_reps);
+    run_small("small vector", short_vector_t(), small_reps);
+    run_small("small vector", small_vector_t(), small_reps);
+    run_small("small string", std_string_t(), small_reps);
+    run_small("small string", short_string_t(), small_reps);
+    run_small("small string", small_string_t(), small_reps);
+    run_small("small map", std_map_t(), small_reps);
+    run_small("small map", short_map_t(), small_reps);
+    run_small("small map", small_flat_map_t(), small_reps);
+}
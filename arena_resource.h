@@ -0,0 +1,265 @@
+#ifndef ARENA_RESOURCE_H
+#define ARENA_RESOURCE_H
+
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 Howard Hinnant
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// arena as a std::pmr::memory_resource.
+//
+// short_alloc<T, N, Align> puts the arena size in the allocator type, so
+// containers over differently sized arenas are different types.  Here the
+// arena is hidden behind std::pmr::memory_resource and the container
+// allocator is std::pmr::polymorphic_allocator, so std::pmr::vector<int>
+// is the same type whatever buffer it lives in:
+//
+//   stack_resource<1024> r;
+//   std::pmr::vector<int> v(&r);
+//
+// arena_resource is monotonic.  Like the arena it wraps, it only takes
+// back the most recent allocation.  arena_pool_resource adds size-class
+// free lists on top, so node-based containers reuse freed nodes instead of
+// leaking arena space.
+//
+// Requests aligned more strictly than the arena go to an upstream
+// memory_resource, std::pmr::new_delete_resource() by default, just as
+// the arena itself sends overflow to ::operator new.
+
+#include "short_alloc.h"
+#include <memory_resource>
+#include <new>
+
+// arena_alignment<Arena>::value is the alignment Arena gives every block
+
+template <class Arena> struct arena_alignment;
+
+template <std::size_t N, std::size_t alignment>
+struct arena_alignment<arena<N, alignment>>
+{
+    static constexpr std::size_t value = alignment;
+};
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+struct arena_alignment<growing_arena<N, alignment, Upstream>>
+{
+    static constexpr std::size_t value = alignment;
+};
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled>
+struct arena_alignment<pooled_arena<N, alignment, MaxPooled>>
+{
+    static constexpr std::size_t value = alignment;
+};
+
+// arena_owns(a, p) is true if p was carved from memory that a manages, and
+// false if a passed the request on to ::operator new.  growing_arena never
+// does, so everything it hands out is its own.
+
+template <std::size_t N, std::size_t alignment>
+inline
+bool
+arena_owns(const arena<N, alignment>& a, const void* p) noexcept
+{
+    return a.owns(p);
+}
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+inline
+bool
+arena_owns(const growing_arena<N, alignment, Upstream>&, const void*) noexcept
+{
+    return true;
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled>
+inline
+bool
+arena_owns(const pooled_arena<N, alignment, MaxPooled>& a,
+           const void* p) noexcept
+{
+    return a.owns(p);
+}
+
+template <class Arena>
+class arena_resource
+    : public std::pmr::memory_resource
+{
+    Arena&                    a_;
+    std::pmr::memory_resource* upstream_;
+
+public:
+    static constexpr std::size_t alignment = arena_alignment<Arena>::value;
+
+    explicit arena_resource(Arena& a,
+          std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        noexcept
+        : a_(a), upstream_(upstream) {}
+    arena_resource(const arena_resource&) = delete;
+    arena_resource& operator=(const arena_resource&) = delete;
+
+    Arena& get_arena() const noexcept {return a_;}
+    std::pmr::memory_resource* upstream_resource() const noexcept
+        {return upstream_;}
+
+private:
+    void*
+    do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        if (align > alignment)
+            return upstream_->allocate(bytes, align);
+        return a_.template allocate<1>(bytes);
+    }
+
+    void
+    do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        if (align > alignment)
+            upstream_->deallocate(p, bytes, align);
+        else
+            a_.deallocate(static_cast<char*>(p), bytes);
+    }
+
+    bool
+    do_is_equal(const std::pmr::memory_resource& r) const noexcept override
+    {
+        return this == &r;
+    }
+};
+
+// Power of two size classes from the arena alignment up to max_pooled
+// bytes, each with a free list threaded through the freed blocks.  A freed
+// block is only reused for its own class.  Larger requests go straight to
+// the arena, as do blocks the arena got from ::operator new once it was
+// full, so those are freed rather than pooled.  Resetting the arena
+// invalidates the free lists, so call release() after reset().
+
+template <class Arena>
+class arena_pool_resource
+    : public std::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t alignment = arena_alignment<Arena>::value;
+    static constexpr std::size_t max_pooled = 1024;
+
+private:
+    static_assert(alignment >= alignof(void*),
+                  "arena_pool_resource needs a pointer aligned arena");
+
+    static constexpr std::size_t smallest =
+        alignment >= sizeof(void*) ? alignment : sizeof(void*);
+    static constexpr std::size_t
+    nclasses(std::size_t n = smallest) noexcept
+        {return n >= max_pooled ? 1 : 1 + nclasses(2 * n);}
+
+    struct node {node* next_;};
+
+    arena_resource<Arena> r_;
+    node*                 free_[nclasses()];
+
+public:
+    explicit arena_pool_resource(Arena& a,
+          std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        noexcept
+        : r_(a, upstream), free_() {}
+    arena_pool_resource(const arena_pool_resource&) = delete;
+    arena_pool_resource& operator=(const arena_pool_resource&) = delete;
+
+    Arena& get_arena() const noexcept {return r_.get_arena();}
+
+    // Forget every free list.  Use after resetting the arena.
+    void release() noexcept
+    {
+        for (node*& f : free_)
+            f = nullptr;
+    }
+
+private:
+    static
+    std::size_t
+    size_class(std::size_t bytes) noexcept
+    {
+        std::size_t c = 0;
+        for (std::size_t n = smallest; n < bytes; n *= 2)
+            ++c;
+        return c;
+    }
+
+    void*
+    do_allocate(std::size_t bytes, std::size_t align) override
+    {
+        if (bytes > max_pooled || align > alignment)
+            return r_.allocate(bytes, align);
+        std::size_t c = size_class(bytes);
+        if (node* n = free_[c])
+        {
+            free_[c] = n->next_;
+            return n;
+        }
+        return r_.allocate(smallest << c, align);
+    }
+
+    void
+    do_deallocate(void* p, std::size_t bytes, std::size_t align) override
+    {
+        if (bytes > max_pooled || align > alignment ||
+            !arena_owns(r_.get_arena(), p))
+        {
+            r_.deallocate(p, bytes, align);
+            return;
+        }
+        std::size_t c = size_class(bytes);
+        node* n = ::new(p) node;
+        n->next_ = free_[c];
+        free_[c] = n;
+    }
+
+    bool
+    do_is_equal(const std::pmr::memory_resource& r) const noexcept override
+    {
+        return this == &r;
+    }
+};
+
+// An arena and a resource over it in one object
+
+template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+class stack_resource
+    : private arena<N, alignment>,
+      public arena_resource<arena<N, alignment>>
+{
+public:
+    stack_resource() noexcept
+        : arena_resource<arena<N, alignment>>(
+              static_cast<arena<N, alignment>&>(*this)) {}
+};
+
+template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+class stack_pool_resource
+    : private arena<N, alignment>,
+      public arena_pool_resource<arena<N, alignment>>
+{
+public:
+    stack_pool_resource() noexcept
+        : arena_pool_resource<arena<N, alignment>>(
+              static_cast<arena<N, alignment>&>(*this)) {}
+};
+
+#endif  // ARENA_RESOURCE_H
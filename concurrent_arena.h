@@ -0,0 +1,348 @@
+#ifndef CONCURRENT_ARENA_H
+#define CONCURRENT_ARENA_H
+
+
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 Howard Hinnant
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// concurrent_arena is an arena that any thread may allocate from and any
+// thread may free to, so that containers built with short_alloc can be
+// handed across threads.
+//
+// The buffer is carved from both ends by one atomic compare-exchange:
+// fixed size chunks from the bottom, allocations larger than MaxPooled
+// bytes from the top.  Each thread using the arena gets one of Slots
+// slots.  It bump-allocates small blocks from its own chunk and keeps
+// freed small blocks in per size class free lists (its magazines), all
+// without atomics.  A small block freed by another thread is pushed onto
+// the owning slot's remote free list, a lock-free stack.  The owner takes
+// the whole list whenever a magazine runs empty.
+//
+// Threads beyond Slots, and large blocks, use the top of the buffer
+// directly.  Like arena, those are only reclaimed when freed last in first
+// out.  When the buffer is exhausted allocation falls back to
+// ::operator new.  reset() must not race with any other use.
+
+#include "short_alloc.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// A small index for the calling thread, reused after the thread exits, so
+// that the live threads hold distinct indices.
+
+class concurrent_arena_thread_index
+{
+    unsigned index_;
+
+    static std::mutex& mut() {static std::mutex m; return m;}
+    static std::vector<unsigned>& free_list() {static std::vector<unsigned> v; return v;}
+    static unsigned& next() {static unsigned n = 0; return n;}
+
+    concurrent_arena_thread_index()
+    {
+        std::lock_guard<std::mutex> _(mut());
+        if (free_list().empty())
+            index_ = next()++;
+        else
+        {
+            index_ = free_list().back();
+            free_list().pop_back();
+        }
+    }
+
+public:
+    ~concurrent_arena_thread_index()
+    {
+        std::lock_guard<std::mutex> _(mut());
+        free_list().push_back(index_);
+    }
+    concurrent_arena_thread_index(const concurrent_arena_thread_index&)
+        = delete;
+    concurrent_arena_thread_index&
+        operator=(const concurrent_arena_thread_index&) = delete;
+
+    static
+    unsigned
+    get()
+    {
+        static thread_local concurrent_arena_thread_index i;
+        return i.index_;
+    }
+};
+
+template <std::size_t N, std::size_t alignment = alignof(std::max_align_t),
+          std::size_t MaxPooled = 16 * alignment,
+          std::size_t ChunkSize = 4096, unsigned Slots = 64>
+class concurrent_arena
+{
+    struct node
+    {
+        node*       next_;
+        std::size_t size_;  // only used on a remote free list
+    };
+
+    static_assert(alignment >= sizeof(node) && alignment % alignof(node) == 0,
+                  "concurrent_arena stores a free list node in each freed block");
+    static_assert(MaxPooled % alignment == 0,
+                  "MaxPooled needs to be a multiple of alignment");
+    static_assert(ChunkSize % alignment == 0 && ChunkSize >= MaxPooled,
+                  "ChunkSize needs to be a multiple of alignment and hold MaxPooled");
+    static_assert(N % alignment == 0, "N needs to be a multiple of alignment");
+    static_assert(N <= 0xFFFFFFFF, "concurrent_arena is limited to 4 GiB");
+    static_assert(Slots <= 0xFFFF, "too many slots");
+
+    static const std::size_t nclasses = MaxPooled / alignment;
+    static const std::size_t nchunks = N / ChunkSize;
+
+    struct alignas(64) slot
+    {
+        char*              cur_;
+        char*              end_;
+        node*              free_[nclasses];
+        std::atomic<node*> remote_;
+    };
+
+    alignas(alignment) char    buf_[N];
+    // bottom (chunks) in the high half, top (large blocks) in the low half
+    std::atomic<std::uint64_t> bounds_;
+    slot                       slots_[Slots];
+    unsigned short             owner_[nchunks == 0 ? 1 : nchunks];
+
+public:
+    ~concurrent_arena() = default;
+    concurrent_arena() noexcept
+        {reset();}
+    concurrent_arena(const concurrent_arena&) = delete;
+    concurrent_arena& operator=(const concurrent_arena&) = delete;
+
+    template <std::size_t ReqAlign> char* allocate(std::size_t n);
+    void deallocate(char* p, std::size_t n) noexcept;
+
+    static constexpr std::size_t size() noexcept {return N;}
+    std::size_t used() const noexcept;
+    void reset() noexcept;
+
+private:
+    static
+    std::size_t
+    align_up(std::size_t n) noexcept
+        {return (n + (alignment-1)) & ~(alignment-1);}
+
+    static std::uint64_t pack(std::uint64_t lo, std::uint64_t hi) noexcept
+        {return lo << 32 | hi;}
+    static std::size_t bottom(std::uint64_t b) noexcept
+        {return static_cast<std::size_t>(b >> 32);}
+    static std::size_t top(std::uint64_t b) noexcept
+        {return static_cast<std::size_t>(b & 0xFFFFFFFF);}
+
+    bool
+    pointer_in_buffer(char* p) const noexcept
+    {
+        return std::uintptr_t(buf_) <= std::uintptr_t(p) &&
+               std::uintptr_t(p) < std::uintptr_t(buf_) + N;
+    }
+
+    char* allocate_small(slot& s, unsigned me, std::size_t aligned_n);
+    char* allocate_large(std::size_t aligned_n);
+    bool new_chunk(slot& s, unsigned me) noexcept;
+    static void drain(slot& s) noexcept;
+};
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+template <std::size_t ReqAlign>
+char*
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::allocate(std::size_t n)
+{
+    static_assert(ReqAlign <= alignment, "alignment is too small for this arena");
+    auto const aligned_n = n == 0 ? alignment : align_up(n);
+    if (aligned_n <= MaxPooled)
+    {
+        unsigned me = concurrent_arena_thread_index::get();
+        if (me < Slots)
+            if (char* r = allocate_small(slots_[me], me, aligned_n))
+                return r;
+    }
+    if (char* r = allocate_large(aligned_n))
+        return r;
+
+    static_assert(alignment <= alignof(std::max_align_t), "you've chosen an "
+                  "alignment that is larger than alignof(std::max_align_t), and "
+                  "cannot be guaranteed by normal operator new");
+    return static_cast<char*>(::operator new(n));
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+char*
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::allocate_small(
+                                 slot& s, unsigned me, std::size_t aligned_n)
+{
+    node*& head = s.free_[aligned_n / alignment - 1];
+    if (head == nullptr && s.remote_.load(std::memory_order_relaxed) != nullptr)
+        drain(s);
+    if (head != nullptr)
+    {
+        node* r = head;
+        head = r->next_;
+        return reinterpret_cast<char*>(r);
+    }
+    if (static_cast<std::size_t>(s.end_ - s.cur_) < aligned_n && !new_chunk(s, me))
+        return nullptr;
+    char* r = s.cur_;
+    s.cur_ += aligned_n;
+    return r;
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+bool
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::new_chunk(
+                                               slot& s, unsigned me) noexcept
+{
+    std::uint64_t b = bounds_.load(std::memory_order_relaxed);
+    do
+    {
+        if (top(b) - bottom(b) < ChunkSize)
+            return false;
+    } while (!bounds_.compare_exchange_weak(b, pack(bottom(b) + ChunkSize, top(b)),
+                                            std::memory_order_relaxed));
+    // The tail of the old chunk is too small to be worth keeping
+    owner_[bottom(b) / ChunkSize] = static_cast<unsigned short>(me);
+    s.cur_ = buf_ + bottom(b);
+    s.end_ = s.cur_ + ChunkSize;
+    return true;
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+char*
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::allocate_large(
+                                                        std::size_t aligned_n)
+{
+    std::uint64_t b = bounds_.load(std::memory_order_relaxed);
+    do
+    {
+        if (top(b) - bottom(b) < aligned_n)
+            return nullptr;
+    } while (!bounds_.compare_exchange_weak(b, pack(bottom(b), top(b) - aligned_n),
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed));
+    // acquire: the space may have just been given back by another thread
+    return buf_ + (top(b) - aligned_n);
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+void
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::drain(slot& s) noexcept
+{
+    node* n = s.remote_.exchange(nullptr, std::memory_order_acquire);
+    while (n != nullptr)
+    {
+        node* next = n->next_;
+        node*& head = s.free_[n->size_ / alignment - 1];
+        n->next_ = head;
+        head = n;
+        n = next;
+    }
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+void
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::deallocate(
+                                                 char* p, std::size_t n) noexcept
+{
+    if (!pointer_in_buffer(p))
+    {
+        ::operator delete(p);
+        return;
+    }
+    auto const aligned_n = n == 0 ? alignment : align_up(n);
+    std::size_t off = static_cast<std::size_t>(p - buf_);
+    std::uint64_t b = bounds_.load(std::memory_order_relaxed);
+    if (off < bottom(b))
+    {
+        // a small block in a slot's chunk
+        unsigned owner = owner_[off / ChunkSize];
+        slot& s = slots_[owner];
+        node* f = ::new(p) node;
+        if (concurrent_arena_thread_index::get() == owner)
+        {
+            node*& head = s.free_[aligned_n / alignment - 1];
+            f->next_ = head;
+            head = f;
+        }
+        else
+        {
+            f->size_ = aligned_n;
+            f->next_ = s.remote_.load(std::memory_order_relaxed);
+            while (!s.remote_.compare_exchange_weak(f->next_, f,
+                                                    std::memory_order_release,
+                                                    std::memory_order_relaxed))
+                ;
+        }
+        return;
+    }
+    // a block from the top: only the most recent one can be given back
+    while (off == top(b) &&
+           !bounds_.compare_exchange_weak(b, pack(bottom(b), top(b) + aligned_n),
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed))
+        ;
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+std::size_t
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::used() const noexcept
+{
+    std::uint64_t b = bounds_.load(std::memory_order_relaxed);
+    return bottom(b) + (N - top(b));
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled,
+          std::size_t ChunkSize, unsigned Slots>
+void
+concurrent_arena<N, alignment, MaxPooled, ChunkSize, Slots>::reset() noexcept
+{
+    bounds_.store(pack(0, N), std::memory_order_relaxed);
+    for (slot& s : slots_)
+    {
+        s.cur_ = s.end_ = nullptr;
+        for (node*& head : s.free_)
+            head = nullptr;
+        s.remote_.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+// short_alloc over a concurrent_arena
+
+template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+using concurrent_short_alloc = short_alloc<T, N, Align,
+                                           concurrent_arena<N, Align>>;
+
+#endif  // CONCURRENT_ARENA_H
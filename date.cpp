@@ -396,6 +396,53 @@ date::date(chrono::year y, chrono::month m, chrono::day d)
     x_ = days_in_years(y.y_) + year_data[m.m_-1] + d.d_;
 }
 
+date::date(chrono::year y, chrono::month m, chrono::day d, no_check_t)
+    : n_(d.n_),
+      dow_(d.dow_)
+{
+    bool leap = is_leap(y.y_);
+    const int* year_data = db[leap];
+    if (n_ != 7)  // if a __day_spec is involved
+    {
+        if (dow_ == 7)  // if we want nth day of month
+        {
+            if (n_ == 6)  // want last day of month
+                d.d_ = year_data[m.m_] - year_data[m.m_-1];
+            else
+                d.d_ = n_;  // want nth day of month
+        }
+        else  // we want nth weekday of month
+        {
+            // dow_ = [0 - 6]
+            // n_ = [1 - 6] 6 means last
+            Int32_t fy =  days_in_years(y.y_);
+            int n_days_in_month = year_data[m.m_] - year_data[m.m_-1];
+            int d;
+            if (n_ == 6)
+            {
+                int ldow = (fy + year_data[m.m_] + 1) % 7;
+                d = n_days_in_month;
+                if (dow_ < ldow)
+                    d -= ldow - dow_;
+                else if (dow_ > ldow)
+                    d -= 7 - (dow_ - ldow);
+            }
+            else
+            {
+                int fdow = (fy + year_data[m.m_-1] + 2) % 7;
+                d = 1 + (n_-1) * 7;
+                if (dow_ < fdow)
+                    d += 7 - (fdow - dow_);
+                else if (dow_ > fdow)
+                    d += dow_ - fdow;
+            }
+            x_ = fy + year_data[m.m_-1] + d;
+            return;
+        }
+    }
+    x_ = days_in_years(y.y_) + year_data[m.m_-1] + d.d_;
+}
+
 #elif DESIGN == 3
 
 date::date(chrono::year y, chrono::month m, chrono::day d)
@@ -457,7 +504,74 @@ date::date(chrono::year y, chrono::month m, chrono::day d)
     }
 }
 
+date::date(chrono::year y, chrono::month m, chrono::day d, no_check_t)
+    : y_(y.y_),
+      m_(m.m_),
+      d_(d.d_),
+      n_(d.n_),
+      dow_(d.dow_)
+{
+    leap_ = is_leap(y_);
+    const int* year_data = db[leap_];
+    if (n_ != 7)  // if a __day_spec is involved
+    {
+        if (dow_ == 7)  // if we want nth day of month
+        {
+            if (n_ == 6)  // want last day of month
+                d_ = year_data[m_] - year_data[m_-1];
+            else
+                d_ = n_;  // want nth day of month
+        }
+        else  // we want nth weekday of month
+        {
+            // dow_ = [0 - 6]
+            // n_ = [1 - 6] 6 means last
+            Int32_t fy =  days_in_years(y.y_);
+            int n_days_in_month = year_data[m_] - year_data[m_-1];
+            int d;
+            if (n_ == 6)
+            {
+                int ldow = (fy + year_data[m_] + 1) % 7;
+                d = n_days_in_month;
+                if (dow_ < ldow)
+                    d -= ldow - dow_;
+                else if (dow_ > ldow)
+                    d -= 7 - (dow_ - ldow);
+            }
+            else
+            {
+                int fdow = (fy + year_data[m_-1] + 2) % 7;
+                d = 1 + (n_-1) * 7;
+                if (dow_ < fdow)
+                    d += 7 - (fdow - dow_);
+                else if (dow_ > fdow)
+                    d += dow_ - fdow;
+            }
+            d_ = d;
+        }
+    }
+}
+
+#endif
+
+date
+date::from_day_number(UInt32_t x)
+{
+    if (!(11322 <= x && x <= 23947853))
+        throw bad_date("day number " + std::to_string(x) + " is out of range");
+    date r;
+#if DESIGN == 1 || DESIGN == 2
+    r.x_ = x;
 #endif
+#if DESIGN == 1 || DESIGN == 3
+    int doy;
+    r.y_ = to_year_and_doy(doy, x);
+    r.leap_ = is_leap(r.y_);
+    r.m_ = mb[r.leap_][doy];
+    r.d_ = static_cast<UInt16_t>(doy - db[r.leap_][r.m_-1]);
+#endif
+    return r;
+}
 
 #if DESIGN == 1
 
@@ -499,7 +613,7 @@ date::operator+=(days d)
     if (!(11322 <= x && x <= 23947853))
         throw bad_date("year is out of range [-32768, 32767]");
     int doy;
-    y_ = to_year_and_doy(doy, x_);
+    y_ = to_year_and_doy(doy, x);
     leap_ = is_leap(y_);
     m_ = mb[leap_][doy];
     d_ = static_cast<UInt16_t>(doy - db[leap_][m_-1]);
@@ -553,7 +667,7 @@ date::operator+=(months mn)
     const bool leap = is_leap(y);
     int m = mb[leap][doy];
     int d = doy - db[leap][m-1];
-    m += mn.x_;
+    m += mn.count();
     if (m < 1)
     {
         int dy = (12 - m) / 12;
@@ -566,8 +680,8 @@ date::operator+=(months mn)
         y += dy;
         m -= 12 * dy;
     }
-    *this = date(chrono::year(y), chrono::month(m, nocheck),
-                 chrono::day(d_, n_, dow_));
+    *this = date(chrono::year(y), chrono::month(m, no_check),
+                 chrono::day(d, n_, dow_));
     return *this;
 }
 
@@ -579,7 +693,7 @@ date::operator+=(years yr)
     const bool leap = is_leap(y);
     const int m = mb[leap][doy];
     const int d = doy - db[leap][m-1];
-    *this = date(chrono::year(y + yr.x_), chrono::month(m, no_check),
+    *this = date(chrono::year(y + yr.count()), chrono::month(m, no_check),
                  chrono::day(d, n_, dow_));
     return *this;
 }
@@ -594,7 +708,7 @@ date::day_from_day_number() const noexcept
     int doy;
     const int y = to_year_and_doy(doy, x_);
     const bool leap = is_leap(y);
-    const m = mb[leap][doy];
+    const int m = mb[leap][doy];
     return static_cast<UInt16_t>(doy - db[leap][m-1]);
 }
 
@@ -622,6 +736,17 @@ date::leap_from_day_number() const noexcept
     return is_leap(y);
 }
 
+date_fields
+date::fields() const noexcept
+{
+    int doy;
+    const int y = to_year_and_doy(doy, x_);
+    const bool leap = is_leap(y);
+    const int m = mb[leap][doy];
+    return date_fields{chrono::year(y, no_check), chrono::month(m, no_check),
+                       chrono::day(doy - db[leap][m-1]), weekday(), leap};
+}
+
 #endif
 
 #if DESIGN == 3
@@ -634,6 +759,54 @@ date::day_number_from_ymd() const noexcept
 
 #endif
 
+// date_cursor
+
+date_cursor::date_cursor(date dt)
+    : x_(dt.day_number())
+{
+    date_fields f = dt.fields();
+    y_ = static_cast<Int16_t>(static_cast<int>(f.year));
+    m_ = static_cast<UInt8_t>(static_cast<int>(f.month));
+    d_ = static_cast<UInt8_t>(static_cast<int>(f.day));
+    wd_ = static_cast<UInt8_t>(static_cast<int>(f.weekday));
+    leap_ = f.is_leap_year;
+    month_days_ = static_cast<UInt8_t>(db[leap_][m_] - db[leap_][m_-1]);
+}
+
+void
+date_cursor::next_month()
+{
+    if (m_ == 12)
+    {
+        if (y_ == 32767)
+            throw bad_date("year is out of range [-32768, 32767]");
+        ++y_;
+        leap_ = is_leap(y_);
+        m_ = 1;
+    }
+    else
+        ++m_;
+    d_ = 1;
+    month_days_ = static_cast<UInt8_t>(db[leap_][m_] - db[leap_][m_-1]);
+}
+
+void
+date_cursor::prev_month()
+{
+    if (m_ == 1)
+    {
+        if (y_ == -32768)
+            throw bad_date("year is out of range [-32768, 32767]");
+        --y_;
+        leap_ = is_leap(y_);
+        m_ = 12;
+    }
+    else
+        --m_;
+    month_days_ = static_cast<UInt8_t>(db[leap_][m_] - db[leap_][m_-1]);
+    d_ = month_days_;
+}
+
 // year_month
 
 bool
@@ -0,0 +1,191 @@
+//  date_bench.cpp
+//
+//  (C) Copyright Howard Hinnant
+//  Use, modification and distribution are subject to the Boost Software License,
+//  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt).
+
+// Checks and timings for date::fields() and date_cursor.
+//
+// Over the whole range of date, date::fields() and a date_cursor stepped
+// forward and then back are compared with the observers of the date made
+// from each day number.  Stepping the cursor past either end of the range,
+// with prefix or postfix ++ and --, must throw bad_date and leave the
+// cursor as it was.  Any failure aborts.
+//
+// Reported is ns per date to read year, month, day and weekday of
+// consecutive dates from 1900 on: with the four observers, with
+// date::fields(), and with a date_cursor.  Build with each of -DDESIGN=1,
+// 2 and 3 to compare the layouts; DESIGN 2 stores only the day number, so
+// it gains the most.
+//
+//   c++ -std=c++14 -O2 -DDESIGN=2 date_bench.cpp date.cpp
+//   ./a.out [dates]
+
+#include "date"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+volatile unsigned sink;  // keeps results alive
+
+void
+check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "check failed: %s\n", what);
+        std::abort();
+    }
+}
+
+void
+print(const char* what, Clock::duration d, std::size_t n)
+{
+    std::printf("%-36s %8.2f\n", what,
+                std::chrono::duration<double, std::nano>(d).count() / n);
+}
+
+bool
+same(const std::chrono::date_fields& f, std::chrono::date d)
+{
+    return f.year == d.year() && f.month == d.month() && f.day == d.day() &&
+           f.weekday == d.weekday() && f.is_leap_year == d.is_leap_year();
+}
+
+bool
+same(const std::chrono::date_cursor& c, std::chrono::date d)
+{
+    return c.day_number() == d.day_number() && *c == d &&
+           (*c).day_number() == d.day_number() && same(c.fields(), d) &&
+           c.year() == d.year() && c.month() == d.month() &&
+           c.day() == d.day() && c.weekday() == d.weekday() &&
+           c.is_leap_year() == d.is_leap_year();
+}
+
+// Each of the four ways of stepping c must throw bad_date and leave c as
+// it was
+void
+check_stuck(std::chrono::date_cursor& c, bool forward)
+{
+    using namespace std::chrono;
+    const date d = *c;
+    for (int i = 0; i < 2; ++i)
+    {
+        bool threw = false;
+        try
+        {
+            if (forward)
+                i == 0 ? ++c : c++;
+            else
+                i == 0 ? --c : c--;
+        }
+        catch (const bad_date&)
+        {
+            threw = true;
+        }
+        check(threw, forward ? "date_cursor: stepped past the last date"
+                             : "date_cursor: stepped before the first date");
+        check(same(c, d), "date_cursor: changed by a step that threw");
+    }
+}
+
+void
+check_fields_and_cursor()
+{
+    using namespace std::chrono;
+    const std::uint32_t lo = (year(-32768)/jan/day(1)).day_number();
+    const std::uint32_t hi = (year(32767)/dec/day(31)).day_number();
+    date_cursor c(date::from_day_number(lo));
+    check_stuck(c, false);
+    for (std::uint32_t x = lo;; ++x)
+    {
+        date d = date::from_day_number(x);
+        check(same(d.fields(), d), "date::fields() differs from the observers");
+        check(same(c, d), "date_cursor differs stepping forward");
+        if (x == hi)
+            break;
+        ++c;
+    }
+    check_stuck(c, true);
+    for (std::uint32_t x = hi;; --x)
+    {
+        check(same(c, date::from_day_number(x)),
+              "date_cursor differs stepping back");
+        if (x == lo)
+            break;
+        date_cursor p = c--;
+        check(p.day_number() == x && p != c && !(p == c),
+              "date_cursor: postfix -- returned the wrong cursor");
+    }
+    check_stuck(c, false);
+    date_cursor p = c++;
+    check(p.day_number() == lo && c.day_number() == lo + 1,
+          "date_cursor: postfix ++ returned the wrong cursor");
+    std::printf("date::fields() and date_cursor: match the observers over "
+                "the whole range\n");
+}
+
+void
+time_fields(std::size_t n)
+{
+    using namespace std::chrono;
+    const std::uint32_t first = (year(1900)/jan/day(1)).day_number();
+    const std::uint32_t hi = (year(32767)/dec/day(31)).day_number();
+    if (n > hi - first + 1)
+        n = hi - first + 1;
+    if (n == 0)
+        return;
+    unsigned s0 = 0;
+    unsigned s1 = 0;
+    unsigned s2 = 0;
+    Clock::time_point t0 = Clock::now();
+    for (std::uint32_t x = first; x < first + n; ++x)
+    {
+        date d = date::from_day_number(x);
+        s0 += static_cast<int>(d.year()) + static_cast<unsigned>(d.month()) +
+              static_cast<unsigned>(d.day()) + static_cast<unsigned>(d.weekday());
+    }
+    Clock::time_point t1 = Clock::now();
+    for (std::uint32_t x = first; x < first + n; ++x)
+    {
+        date_fields f = date::from_day_number(x).fields();
+        s1 += static_cast<int>(f.year) + static_cast<unsigned>(f.month) +
+              static_cast<unsigned>(f.day) + static_cast<unsigned>(f.weekday);
+    }
+    Clock::time_point t2 = Clock::now();
+    date_cursor c(date::from_day_number(first));
+    for (std::size_t i = 0;;)
+    {
+        s2 += static_cast<int>(c.year()) + static_cast<unsigned>(c.month()) +
+              static_cast<unsigned>(c.day()) + static_cast<unsigned>(c.weekday());
+        if (++i == n)
+            break;
+        ++c;
+    }
+    Clock::time_point t3 = Clock::now();
+    check(s0 == s1 && s1 == s2, "timing: the three ways disagree");
+    sink = s2;
+    print("observers", t1 - t0, n);
+    print("date::fields()", t2 - t1, n);
+    print("date_cursor", t3 - t2, n);
+}
+
+}  // unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::size_t n = 10000000;
+    if (argc > 1)
+        n = std::strtoul(argv[1], nullptr, 10);
+    check_fields_and_cursor();
+    std::printf("\ndate, DESIGN %-24d %8s\n", DESIGN, "ns/date");
+    time_fields(n);
+}
@@ -0,0 +1,865 @@
+//  date_columns.cpp
+//
+//  (C) Copyright Howard Hinnant
+//  Use, modification and distribution are subject to the Boost Software License,
+//  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt).
+
+#include <cerrno>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define DATE_COLUMNS_MMAP 1
+#endif
+
+// Where ifuncs are available, gcc builds an AVX2 clone of each column loop
+// below and picks one at load time, so a default -march build still gets 8
+// lanes.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && \
+    defined(__linux__)
+#  define DATE_COLUMNS_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#  define DATE_COLUMNS_CLONES
+#endif
+
+#include "date_columns"
+
+#ifdef _LIBCPP_BEGIN_NAMESPACE_STD
+_LIBCPP_BEGIN_NAMESPACE_STD
+#else
+namespace std {
+#endif
+namespace chrono
+{
+
+static const char column_magic[8] = {'H', 'H', 'D', 'C', 'O', 'L', '\r', '\n'};
+static const UInt32_t column_version = 1;
+
+static
+void
+store_le32(unsigned char* p, UInt32_t x) noexcept
+{
+    for (int i = 0; i < 4; ++i, x >>= 8)
+        p[i] = static_cast<unsigned char>(x);
+}
+
+static
+void
+store_le64(unsigned char* p, UInt64_t x) noexcept
+{
+    for (int i = 0; i < 8; ++i, x >>= 8)
+        p[i] = static_cast<unsigned char>(x);
+}
+
+static
+std::size_t
+payload_bytes(std::size_t n, unsigned width) noexcept
+{
+    if (width == 0 || n < 2)
+        return 0;
+    // 8 bytes of slack so that decoding can always load 8 bytes at a time
+    const UInt64_t bits = UInt64_t(n - 1) * width;
+    return static_cast<std::size_t>(((bits + 7) / 8 + 7 + 7) & ~UInt64_t(7));
+}
+
+struct column_header
+{
+    column_kind kind;
+    UInt32_t block_size;
+    Int64_t num;
+    Int64_t den;
+};
+
+static
+column_header
+read_header(const unsigned char* p, std::size_t len)
+{
+    if (len < __column_header_size || std::memcmp(p, column_magic, 8) != 0)
+        throw bad_column_file("not a date column file");
+    if (__load_le32(p+8) != column_version)
+        throw bad_column_file("unsupported date column file version " +
+                              std::to_string(__load_le32(p+8)));
+    column_header h;
+    if (!(1 <= p[12] && p[12] <= 3))
+        throw bad_column_file("unknown column kind " + std::to_string(p[12]));
+    h.kind = static_cast<column_kind>(p[12]);
+    h.block_size = __load_le32(p+16);
+    h.num = static_cast<Int64_t>(__load_le64(p+24));
+    h.den = static_cast<Int64_t>(__load_le64(p+32));
+    return h;
+}
+
+// Visits every complete block after the header and returns the length of
+// the file up to the end of the last one.
+
+template <class F>
+static
+std::size_t
+walk_blocks(const unsigned char* p, std::size_t len, F f)
+{
+    std::size_t off = __column_header_size;
+    while (len - off >= __column_block_header_size)
+    {
+        const unsigned char* b = p + off;
+        const UInt32_t n = __load_le32(b);
+        const unsigned width = b[4];
+        const UInt64_t bytes = __load_le64(b+8);
+        if (n == 0 || width > 64 || bytes != payload_bytes(n, width) ||
+            bytes > len - off - __column_block_header_size)
+            break;
+        f(off, n);
+        off += __column_block_header_size + static_cast<std::size_t>(bytes);
+    }
+    return off;
+}
+
+// column_file
+
+column_file::column_file(const std::string& path)
+    : data_(nullptr),
+      len_(0),
+      mapped_(false),
+      size_(0)
+{
+#if DATE_COLUMNS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        int e = errno;
+        ::close(fd);
+        throw std::system_error(e, std::generic_category(), path);
+    }
+    len_ = static_cast<std::size_t>(st.st_size);
+    if (len_ > 0)
+    {
+        void* p = ::mmap(nullptr, len_, PROT_READ, MAP_SHARED, fd, 0);
+        int e = errno;
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw std::system_error(e, std::generic_category(), path);
+        data_ = static_cast<const unsigned char*>(p);
+        mapped_ = true;
+    }
+    else
+        ::close(fd);
+#else  // DATE_COLUMNS_MMAP
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        throw std::system_error(errno, std::generic_category(), path);
+    std::vector<unsigned char> buf;
+    unsigned char chunk[4096];
+    for (std::size_t k; (k = std::fread(chunk, 1, sizeof(chunk), f)) > 0;)
+        buf.insert(buf.end(), chunk, chunk + k);
+    std::fclose(f);
+    len_ = buf.size();
+    unsigned char* p = static_cast<unsigned char*>(::operator new(len_ + 1));
+    std::memcpy(p, buf.data(), len_);
+    data_ = p;
+#endif  // DATE_COLUMNS_MMAP
+    try
+    {
+        column_header h = read_header(data_, len_);
+        kind_ = h.kind;
+        num_ = h.num;
+        den_ = h.den;
+        walk_blocks(data_, len_, [this](std::size_t off, std::size_t n)
+        {
+            offsets_.push_back(off);
+            starts_.push_back(size_);
+            size_ += n;
+        });
+        starts_.push_back(size_);
+    }
+    catch (...)
+    {
+        __release();
+        throw;
+    }
+#if DATE_COLUMNS_MMAP && defined(MADV_WILLNEED)
+    if (mapped_)
+        ::madvise(const_cast<unsigned char*>(data_), len_, MADV_WILLNEED);
+#endif
+}
+
+void
+column_file::__release() noexcept
+{
+#if DATE_COLUMNS_MMAP
+    if (mapped_)
+        ::munmap(const_cast<unsigned char*>(data_), len_);
+#else
+    ::operator delete(const_cast<unsigned char*>(data_));
+#endif
+    data_ = nullptr;
+    len_ = 0;
+    mapped_ = false;
+}
+
+column_file::~column_file()
+{
+    __release();
+}
+
+column_file::column_file(column_file&& f) noexcept
+    : data_(f.data_),
+      len_(f.len_),
+      mapped_(f.mapped_),
+      kind_(f.kind_),
+      num_(f.num_),
+      den_(f.den_),
+      offsets_(std::move(f.offsets_)),
+      starts_(std::move(f.starts_)),
+      size_(f.size_)
+{
+    f.data_ = nullptr;
+    f.len_ = 0;
+    f.mapped_ = false;
+    f.size_ = 0;
+}
+
+column_file&
+column_file::operator=(column_file&& f) noexcept
+{
+    if (this != &f)
+    {
+        __release();
+        data_ = f.data_;
+        len_ = f.len_;
+        mapped_ = f.mapped_;
+        kind_ = f.kind_;
+        num_ = f.num_;
+        den_ = f.den_;
+        offsets_ = std::move(f.offsets_);
+        starts_ = std::move(f.starts_);
+        size_ = f.size_;
+        f.data_ = nullptr;
+        f.len_ = 0;
+        f.mapped_ = false;
+        f.size_ = 0;
+    }
+    return *this;
+}
+
+static
+const char*
+kind_name(column_kind k) noexcept
+{
+    switch (k)
+    {
+    case column_kind::date:
+        return "date";
+    case column_kind::year_month:
+        return "year_month";
+    case column_kind::duration:
+        return "duration";
+    }
+    return "unknown";
+}
+
+static
+void
+check_header(const column_header& h, column_kind kind, Int64_t num, Int64_t den)
+{
+    if (h.kind != kind)
+        throw bad_column_file(std::string("column holds ") + kind_name(h.kind) +
+                              ", not " + kind_name(kind));
+    if (h.num != num || h.den != den)
+        throw bad_column_file("column period is " + std::to_string(h.num) + '/' +
+                              std::to_string(h.den) + ", not " +
+                              std::to_string(num) + '/' + std::to_string(den));
+}
+
+void
+__check_column_file(const column_file& f, column_kind kind, Int64_t num,
+                    Int64_t den)
+{
+    column_header h = {f.kind(), 0, f.period_num(), f.period_den()};
+    check_header(h, kind, num, den);
+}
+
+// column_writer
+
+std::FILE*
+__open_column_for_append(const std::string& path, column_kind kind,
+                         Int64_t num, Int64_t den, std::size_t block_size)
+{
+    if (block_size == 0 || block_size > 0xFFFFFFFF)
+        throw std::invalid_argument("column_writer: block size " +
+                                    std::to_string(block_size) +
+                                    " is out of range");
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (f != nullptr)
+    {
+        std::vector<unsigned char> buf;
+        unsigned char chunk[4096];
+        for (std::size_t k; (k = std::fread(chunk, 1, sizeof(chunk), f)) > 0;)
+            buf.insert(buf.end(), chunk, chunk + k);
+        std::fclose(f);
+        if (!buf.empty())
+        {
+            check_header(read_header(buf.data(), buf.size()), kind, num, den);
+            std::size_t good = walk_blocks(buf.data(), buf.size(),
+                                           [](std::size_t, std::size_t) {});
+            if (good != buf.size())
+            {
+                // drop the tail of an interrupted write
+#if DATE_COLUMNS_MMAP
+                if (::truncate(path.c_str(), static_cast<off_t>(good)) != 0)
+                    throw std::system_error(errno, std::generic_category(), path);
+#else
+                throw bad_column_file(path + " ends in an incomplete block");
+#endif
+            }
+            f = std::fopen(path.c_str(), "ab");
+            if (f == nullptr)
+                throw std::system_error(errno, std::generic_category(), path);
+            return f;
+        }
+    }
+    f = std::fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        throw std::system_error(errno, std::generic_category(), path);
+    unsigned char h[__column_header_size] = {};
+    std::memcpy(h, column_magic, 8);
+    store_le32(h+8, column_version);
+    h[12] = static_cast<unsigned char>(kind);
+    store_le32(h+16, static_cast<UInt32_t>(block_size));
+    store_le64(h+24, static_cast<UInt64_t>(num));
+    store_le64(h+32, static_cast<UInt64_t>(den));
+    if (std::fwrite(h, 1, sizeof(h), f) != sizeof(h) || std::fflush(f) != 0)
+    {
+        std::fclose(f);
+        throw bad_column_file("column_writer: write to " + path + " failed");
+    }
+    return f;
+}
+
+// Differences are taken modulo 2^64 so that any pair of int64_t values has
+// one.  They are ordered as signed values to find the smallest, which leaves
+// every difference less the smallest in [0, 2^64).
+
+void
+__write_column_block(std::FILE* f, const Int64_t* v, std::size_t n,
+                     std::vector<unsigned char>& buf)
+{
+    Int64_t lo = 0;
+    Int64_t hi = 0;
+    for (std::size_t i = 1; i < n; ++i)
+    {
+        Int64_t d = static_cast<Int64_t>(UInt64_t(v[i]) - UInt64_t(v[i-1]));
+        if (i == 1 || d < lo)
+            lo = d;
+        if (i == 1 || d > hi)
+            hi = d;
+    }
+    const UInt64_t range = UInt64_t(hi) - UInt64_t(lo);
+    unsigned width = 0;
+    while (width < 64 && (range >> width) != 0)
+        ++width;
+    const std::size_t bytes = payload_bytes(n, width);
+    buf.assign(__column_block_header_size + bytes, 0);
+    unsigned char* p = buf.data();
+    store_le32(p, static_cast<UInt32_t>(n));
+    p[4] = static_cast<unsigned char>(width);
+    store_le64(p+8, bytes);
+    store_le64(p+16, static_cast<UInt64_t>(v[0]));
+    store_le64(p+24, static_cast<UInt64_t>(lo));
+    if (width > 0)
+    {
+        unsigned char* out = p + __column_block_header_size;
+        std::size_t bit = 0;
+        for (std::size_t i = 1; i < n; ++i, bit += width)
+        {
+            UInt64_t x = UInt64_t(v[i]) - UInt64_t(v[i-1]) - UInt64_t(lo);
+            std::size_t b = bit >> 3;
+            const unsigned s = bit & 7;
+            out[b++] |= static_cast<unsigned char>(x << s);
+            x >>= 8 - s;
+            for (int left = static_cast<int>(width) - (8 - static_cast<int>(s));
+                 left > 0; left -= 8, x >>= 8)
+                out[b++] |= static_cast<unsigned char>(x);
+        }
+    }
+    if (std::fwrite(p, 1, buf.size(), f) != buf.size())
+        throw bad_column_file("column_writer: write failed");
+}
+
+// Column arithmetic
+
+// Runs f(first, last) over [0, n) split into at most threads parts, the
+// first on the calling thread, and returns the sum of the results.  Parts
+// are multiples of 64 elements so that no two threads write to the same
+// cache line of a cache line aligned column.  If a thread cannot be
+// started, its part runs on the calling thread instead.
+
+template <class F>
+static
+std::size_t
+run_parallel(std::size_t n, unsigned threads, F f)
+{
+    const std::size_t grain = 1 << 16;
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    std::size_t parts = std::min<std::size_t>(threads, (n + grain - 1) / grain);
+    if (parts <= 1)
+        return f(std::size_t(0), n);
+    const std::size_t chunk = ((n + parts - 1) / parts + 63) & ~std::size_t(63);
+    std::vector<std::size_t> results(parts, 0);
+    std::vector<std::thread> th;
+    th.reserve(parts - 1);
+    std::size_t started = 1;
+    try
+    {
+        for (; started < parts; ++started)
+        {
+            const std::size_t first = std::min(n, started * chunk);
+            const std::size_t last = std::min(n, first + chunk);
+            th.emplace_back([&f, &results, started, first, last]
+                            {results[started] = f(first, last);});
+        }
+    }
+    catch (const std::system_error&)
+    {
+    }
+    std::size_t r = f(std::size_t(0), std::min(n, chunk));
+    for (std::size_t p = started; p < parts; ++p)
+        r += f(std::min(n, p * chunk), std::min(n, (p + 1) * chunk));
+    for (std::size_t p = 0; p < th.size(); ++p)
+    {
+        th[p].join();
+        r += results[p+1];
+    }
+    return r;
+}
+
+// Both conversions follow days_from_civil and civil_from_days from
+// date_algorithms.html.  Years are counted from -32800, a multiple of 400,
+// so that every quantity is unsigned and each division is by a constant.
+// -32800-03-01, the start of that first 400 year era, is day number -306.
+// Only the selects below depend on the data, so the loop vectorizes.  It
+// runs over fixed size local arrays: gcc vectorizes that at -O2, where it
+// would not vectorize an open ended loop, and in and out may then overlap.
+
+// Runs k <= month_run values, returning how many are out of range.
+
+const std::size_t month_run = 256;
+
+template <end_of_month eom>
+DATE_COLUMNS_CLONES
+static
+std::size_t
+add_months_run(const UInt32_t* in, UInt32_t* out, std::size_t k, Int32_t dm)
+    noexcept
+{
+    UInt32_t a[month_run];
+    UInt32_t b[month_run];
+    std::memcpy(a, in, k * sizeof(UInt32_t));
+    std::fill(a + k, a + month_run, UInt32_t(11322));
+    for (std::size_t i = 0; i < month_run; ++i)
+    {
+        const UInt32_t x = a[i];
+        const bool valid = 11322 <= x && x <= 23947853;
+        // civil_from_days
+        const UInt32_t z = (valid ? x : 11322) + 306;
+        const UInt32_t era = z / 146097;
+        const UInt32_t doe = z - era * 146097;
+        const UInt32_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+        const UInt32_t doy = doe - (365*yoe + yoe/4 - yoe/100);
+        const UInt32_t mp = (5*doy + 2)/153;
+        const UInt32_t d = doy - (153*mp + 2)/5 + 1;
+        const UInt32_t m = mp < 10 ? mp + 3 : mp - 9;
+        const UInt32_t y = era*400 + yoe + (m <= 2);
+        // shift, keeping the year within [-32768, 32767], here [32, 65567]
+        const Int32_t ym = static_cast<Int32_t>(y*12 + m - 1) + dm;
+        const bool ok = valid && 32*12 <= ym && ym < 65568*12;
+        const UInt32_t ym2 = ok ? static_cast<UInt32_t>(ym) : y*12 + m - 1;
+        const UInt32_t y2 = ym2 / 12;
+        const UInt32_t m2 = ym2 - y2*12 + 1;
+        const UInt32_t leap2 = (y2 % 4 == 0) & ((y2 % 100 != 0) | (y2 % 400 == 0));
+        const UInt32_t last2 = m2 == 2 ? 28 + leap2 : 30 | ((m2 ^ (m2 >> 3)) & 1);
+        UInt32_t d2;
+        if (eom == end_of_month::overflow)
+            d2 = d;  // days_from_civil carries it into the next month
+        else if (eom == end_of_month::clamp)
+            d2 = d < last2 ? d : last2;
+        else
+        {
+            const UInt32_t leap = (y % 4 == 0) & ((y % 100 != 0) | (y % 400 == 0));
+            const UInt32_t last = m == 2 ? 28 + leap : 30 | ((m ^ (m >> 3)) & 1);
+            d2 = d == last || d > last2 ? last2 : d;
+        }
+        // days_from_civil
+        const UInt32_t yy = y2 - (m2 <= 2);
+        const UInt32_t era2 = yy / 400;
+        const UInt32_t yoe2 = yy - era2 * 400;
+        const UInt32_t doy2 = (153*(m2 > 2 ? m2 - 3 : m2 + 9) + 2)/5 + d2 - 1;
+        const UInt32_t doe2 = yoe2*365 + yoe2/4 - yoe2/100 + doy2;
+        b[i] = ok ? era2*146097 + doe2 - 306 : 0;
+    }
+    std::memcpy(out, b, k * sizeof(UInt32_t));
+    std::size_t bad = 0;
+    for (std::size_t i = 0; i < k; ++i)
+        bad += b[i] == 0;
+    return bad;
+}
+
+template <end_of_month eom>
+static
+std::size_t
+add_months_loop(const UInt32_t* in, UInt32_t* out, std::size_t n, Int32_t dm)
+    noexcept
+{
+    std::size_t bad = 0;
+    for (std::size_t first = 0; first < n; first += month_run)
+        bad += add_months_run<eom>(in + first, out + first,
+                                   std::min(month_run, n - first), dm);
+    return bad;
+}
+
+std::size_t
+add_months(const UInt32_t* in, UInt32_t* out, std::size_t n, months m,
+           end_of_month eom) noexcept
+{
+    // |dm| beyond the 786432 months of date is out of range anyway
+    const Int32_t dm = std::max(-(1 << 24), std::min(m.count(), 1 << 24));
+    switch (eom)
+    {
+    case end_of_month::clamp:
+        return add_months_loop<end_of_month::clamp>(in, out, n, dm);
+    case end_of_month::overflow:
+        return add_months_loop<end_of_month::overflow>(in, out, n, dm);
+    case end_of_month::last_day:
+        return add_months_loop<end_of_month::last_day>(in, out, n, dm);
+    }
+    return 0;
+}
+
+std::size_t
+parallel_add_months(const UInt32_t* in, UInt32_t* out, std::size_t n,
+                    months m, end_of_month eom, unsigned threads)
+{
+    return run_parallel(n, threads, [=](std::size_t first, std::size_t last)
+        {return add_months(in + first, out + first, last - first, m, eom);});
+}
+
+// date_dimension
+
+static const char dimension_magic[8] = {'H', 'H', 'D', 'D', 'I', 'M', '\r', '\n'};
+static const UInt32_t dimension_version = 1;
+static const UInt32_t byte_order_mark = 0x01020304;
+static const std::size_t dimension_header_size = 64;
+
+// header:  magic[8] version:u32 byte_order:u32 first:u32 last:u32
+//          column_bytes:u64 pad[24]
+
+date_dimension::date_dimension(UInt32_t first, UInt32_t last, unsigned threads)
+    : first_(first),
+      last_(last),
+      buf_(nullptr),
+      len_(0),
+      map_(nullptr)
+{
+    if (!(11322 <= first && first <= last && last <= 23947853))
+        throw bad_date("date_dimension: day numbers [" + std::to_string(first) +
+                       ", " + std::to_string(last) + "] are out of range");
+    const std::size_t bytes = __offset(__columns, size());
+    map_ = static_cast<unsigned char*>(::operator new(bytes + 63));
+    buf_ = reinterpret_cast<unsigned char*>(
+                     (reinterpret_cast<std::uintptr_t>(map_) + 63) &
+                     ~std::uintptr_t(63));
+    try
+    {
+        run_parallel(size(), threads, [this](std::size_t i, std::size_t j)
+        {
+            __build(i, j);
+            return std::size_t(0);
+        });
+    }
+    catch (...)
+    {
+        __release();
+        throw;
+    }
+}
+
+// One pass of civil_from_days (see add_months_run) per day.  The ISO week
+// is the week of the Thursday of the same Monday based week, which is at
+// most three days away and so in the same year, or the one before or after.
+// -32768-01-01 is a Thursday and 32767-12-31 a Sunday, so ISO years stay
+// within the range of year.
+
+void
+date_dimension::__build(std::size_t first, std::size_t last) noexcept
+{
+    Int16_t* year = reinterpret_cast<Int16_t*>(__column(__year));
+    UInt16_t* day_of_year = reinterpret_cast<UInt16_t*>(__column(__day_of_year));
+    Int16_t* iso_year = reinterpret_cast<Int16_t*>(__column(__iso_year));
+    UInt8_t* month = __column(__month);
+    UInt8_t* day = __column(__day);
+    UInt8_t* weekday = __column(__weekday);
+    UInt8_t* leap = __column(__leap);
+    UInt8_t* quarter = __column(__quarter);
+    UInt8_t* iso_week = __column(__iso_week);
+    for (std::size_t i = first; i < last; ++i)
+    {
+        const UInt32_t x = first_ + static_cast<UInt32_t>(i);
+        // civil_from_days, years counted from -32800
+        const UInt32_t z = x + 306;
+        const UInt32_t era = z / 146097;
+        const UInt32_t doe = z - era * 146097;
+        const UInt32_t yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+        const UInt32_t doym = doe - (365*yoe + yoe/4 - yoe/100);  // from mar/1
+        const UInt32_t mp = (5*doym + 2)/153;
+        const UInt32_t d = doym - (153*mp + 2)/5 + 1;
+        const UInt32_t m = mp < 10 ? mp + 3 : mp - 9;
+        const UInt32_t y = era*400 + yoe + (m <= 2);
+        const UInt32_t lp = (y % 4 == 0) & ((y % 100 != 0) | (y % 400 == 0));
+        const Int32_t doy = static_cast<Int32_t>(doym >= 306 ? doym - 305
+                                                             : doym + 60 + lp);
+        const UInt32_t wd = (x + 1) % 7;
+        // ISO week
+        const Int32_t thursday = doy + 3 - static_cast<Int32_t>((wd + 6) % 7);
+        const Int32_t year_len = 365 + static_cast<Int32_t>(lp);
+        const UInt32_t py = y - 1;
+        const Int32_t prev_len = 365 + static_cast<Int32_t>(
+                         (py % 4 == 0) & ((py % 100 != 0) | (py % 400 == 0)));
+        Int32_t iy = static_cast<Int32_t>(y) - 32800;
+        Int32_t td = thursday;
+        if (thursday < 1)
+        {
+            --iy;
+            td += prev_len;
+        }
+        else if (thursday > year_len)
+        {
+            ++iy;
+            td -= year_len;
+        }
+        year[i] = static_cast<Int16_t>(static_cast<Int32_t>(y) - 32800);
+        month[i] = static_cast<UInt8_t>(m);
+        day[i] = static_cast<UInt8_t>(d);
+        weekday[i] = static_cast<UInt8_t>(wd);
+        leap[i] = static_cast<UInt8_t>(lp);
+        quarter[i] = static_cast<UInt8_t>((m + 2) / 3);
+        day_of_year[i] = static_cast<UInt16_t>(doy);
+        iso_year[i] = static_cast<Int16_t>(iy);
+        iso_week[i] = static_cast<UInt8_t>((td - 1) / 7 + 1);
+    }
+}
+
+date_dimension::date_dimension(const std::string& path)
+    : first_(0),
+      last_(0),
+      buf_(nullptr),
+      len_(0),
+      map_(nullptr)
+{
+    unsigned char h[dimension_header_size];
+#if DATE_COLUMNS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        int e = errno;
+        ::close(fd);
+        throw std::system_error(e, std::generic_category(), path);
+    }
+    const std::size_t file_len = static_cast<std::size_t>(st.st_size);
+    if (file_len < sizeof(h) || ::pread(fd, h, sizeof(h), 0) != sizeof(h))
+    {
+        ::close(fd);
+        throw bad_column_file(path + " is not a date_dimension file");
+    }
+#else
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        throw std::system_error(errno, std::generic_category(), path);
+    if (std::fread(h, 1, sizeof(h), f) != sizeof(h))
+    {
+        std::fclose(f);
+        throw bad_column_file(path + " is not a date_dimension file");
+    }
+#endif
+    if (std::memcmp(h, dimension_magic, 8) != 0 ||
+        __load_le32(h+8) != dimension_version)
+    {
+#if DATE_COLUMNS_MMAP
+        ::close(fd);
+#else
+        std::fclose(f);
+#endif
+        throw bad_column_file(path + " is not a date_dimension file");
+    }
+    UInt32_t bom;
+    std::memcpy(&bom, h+12, sizeof(bom));
+    first_ = __load_le32(h+16);
+    last_ = __load_le32(h+20);
+    const UInt64_t bytes = __load_le64(h+24);
+    const bool bad = bom != byte_order_mark ||
+                     !(11322 <= first_ && first_ <= last_ && last_ <= 23947853) ||
+                     bytes != __offset(__columns, size())
+#if DATE_COLUMNS_MMAP
+                     || bytes > file_len - dimension_header_size
+#endif
+                     ;
+    if (bad)
+    {
+#if DATE_COLUMNS_MMAP
+        ::close(fd);
+#else
+        std::fclose(f);
+#endif
+        throw bad_column_file(path + (bom != byte_order_mark ?
+                              " was saved with another byte order" :
+                              " is a damaged date_dimension file"));
+    }
+#if DATE_COLUMNS_MMAP
+    len_ = dimension_header_size + static_cast<std::size_t>(bytes);
+    void* p = ::mmap(nullptr, len_, PROT_READ, MAP_SHARED, fd, 0);
+    int e = errno;
+    ::close(fd);
+    if (p == MAP_FAILED)
+    {
+        len_ = 0;
+        throw std::system_error(e, std::generic_category(), path);
+    }
+    map_ = static_cast<unsigned char*>(p);
+    buf_ = map_ + dimension_header_size;
+#else
+    map_ = static_cast<unsigned char*>(::operator new(bytes + 63));
+    buf_ = reinterpret_cast<unsigned char*>(
+                     (reinterpret_cast<std::uintptr_t>(map_) + 63) &
+                     ~std::uintptr_t(63));
+    const bool read = std::fread(buf_, 1, bytes, f) == bytes;
+    std::fclose(f);
+    if (!read)
+    {
+        __release();
+        throw bad_column_file(path + " is a damaged date_dimension file");
+    }
+#endif
+}
+
+date_dimension
+date_dimension::load_or_build(const std::string& path, UInt32_t first,
+                              UInt32_t last, unsigned threads)
+{
+    try
+    {
+        date_dimension d(path);
+        if (d.first() <= first && last <= d.last())
+            return d;
+    }
+    catch (const std::system_error& e)
+    {
+        if (e.code() != std::errc::no_such_file_or_directory)
+            throw;
+    }
+    catch (const bad_column_file&)
+    {
+        // rebuilt below
+    }
+    date_dimension d(first, last, threads);
+    d.save(path);
+    return d;
+}
+
+// Written to a temporary file and renamed into place, so that a process
+// mapping path sees either the old table or the whole new one.
+
+void
+date_dimension::save(const std::string& path) const
+{
+#if DATE_COLUMNS_MMAP
+    const std::string tmp = path + ".tmp" + std::to_string(::getpid());
+#else
+    const std::string tmp = path + ".tmp";
+#endif
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (f == nullptr)
+        throw std::system_error(errno, std::generic_category(), tmp);
+    unsigned char h[dimension_header_size] = {};
+    const std::size_t bytes = __offset(__columns, size());
+    std::memcpy(h, dimension_magic, 8);
+    store_le32(h+8, dimension_version);
+    std::memcpy(h+12, &byte_order_mark, sizeof(byte_order_mark));
+    store_le32(h+16, first_);
+    store_le32(h+20, last_);
+    store_le64(h+24, bytes);
+    bool ok = std::fwrite(h, 1, sizeof(h), f) == sizeof(h) &&
+              std::fwrite(buf_, 1, bytes, f) == bytes;
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp.c_str());
+        throw bad_column_file("date_dimension: could not save " + path);
+    }
+}
+
+void
+date_dimension::__release() noexcept
+{
+#if DATE_COLUMNS_MMAP
+    if (len_ != 0)
+        ::munmap(map_, len_);
+    else
+#endif
+        ::operator delete(map_);
+    map_ = nullptr;
+    buf_ = nullptr;
+    len_ = 0;
+}
+
+date_dimension::~date_dimension()
+{
+    __release();
+}
+
+date_dimension::date_dimension(date_dimension&& d) noexcept
+    : first_(d.first_),
+      last_(d.last_),
+      buf_(d.buf_),
+      len_(d.len_),
+      map_(d.map_)
+{
+    d.buf_ = nullptr;
+    d.len_ = 0;
+    d.map_ = nullptr;
+}
+
+date_dimension&
+date_dimension::operator=(date_dimension&& d) noexcept
+{
+    if (this != &d)
+    {
+        __release();
+        first_ = d.first_;
+        last_ = d.last_;
+        buf_ = d.buf_;
+        len_ = d.len_;
+        map_ = d.map_;
+        d.buf_ = nullptr;
+        d.len_ = 0;
+        d.map_ = nullptr;
+    }
+    return *this;
+}
+
+}  // chrono
+
+#ifdef _LIBCPP_END_NAMESPACE_STD
+_LIBCPP_END_NAMESPACE_STD
+#else
+}  // std
+#endif
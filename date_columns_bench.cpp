@@ -0,0 +1,516 @@
+//  date_columns_bench.cpp
+//
+//  (C) Copyright Howard Hinnant
+//  Use, modification and distribution are subject to the Boost Software License,
+//  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt).
+
+// Checks and timings for date_columns.
+//
+// Column files are written and read back for each kind, at odd block sizes,
+// with differences up to the full range of int64_t, and decoded across
+// block boundaries.  A file is then cut short at every point of its last
+// block: readers must see only the whole blocks before the cut, and the
+// next writer must drop the partial block and append after them.
+// add_months, add_years and their parallel forms are compared with date
+// arithmetic for each end_of_month, including results and inputs outside
+// the range of date.  Every column of a date_dimension is compared with
+// the date observers, and its ISO year and week with strftime %G and %V,
+// and the table is saved, mapped and compared again.  Any failure aborts.
+//
+// Reported is ns per value to write a column of day numbers and to decode
+// it back into uint32_t, and to shift a column by a month with add_months,
+// with parallel_add_months, and with date::operator+=(months) on each date
+// (catching the bad_date it throws for a day past the end of the month).
+// Reported also is ns per day to build a 200 year date_dimension, and us
+// to map a saved one.  A scratch file is written in the current directory
+// and removed at exit.
+//
+//   c++ -std=c++14 -O2 -pthread date_columns_bench.cpp date_columns.cpp date.cpp
+//   ./a.out [values]
+
+#include "date_columns"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+const char scratch[] = "date_columns_bench.tmp";
+
+volatile std::uint32_t sink;  // keeps results alive
+
+void
+check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "check failed: %s\n", what);
+        std::remove(scratch);
+        std::abort();
+    }
+}
+
+void
+print(const char* what, Clock::duration d, std::size_t n)
+{
+    std::printf("%-36s %8.2f\n", what,
+                std::chrono::duration<double, std::nano>(d).count() / n);
+}
+
+std::size_t
+file_size(const char* path)
+{
+    std::FILE* f = std::fopen(path, "rb");
+    check(f != nullptr, "cannot open the scratch file");
+    std::fseek(f, 0, SEEK_END);
+    long n = std::ftell(f);
+    std::fclose(f);
+    return static_cast<std::size_t>(n);
+}
+
+// Keeps the first n bytes of path, as an interrupted write would leave it
+
+void
+cut(const char* path, std::size_t n)
+{
+    std::vector<char> bytes(file_size(path));
+    std::FILE* f = std::fopen(path, "rb");
+    check(std::fread(bytes.data(), 1, bytes.size(), f) == bytes.size(),
+          "cannot read the scratch file");
+    std::fclose(f);
+    f = std::fopen(path, "wb");
+    check(std::fwrite(bytes.data(), 1, n, f) == n,
+          "cannot write the scratch file");
+    std::fclose(f);
+}
+
+// Writes v as a column of T in blocks of block_size, then reads it back
+// whole, raw, and in pieces that straddle the block boundaries
+
+template <class T>
+void
+round_trip(const std::vector<T>& v, std::size_t block_size, const char* what)
+{
+    typedef std::chrono::column_traits<T> traits;
+    std::remove(scratch);
+    {
+        std::chrono::column_writer<T> w(scratch, block_size);
+        w.append(v.data(), v.size());
+    }
+    std::chrono::column_reader<T> r(scratch);
+    check(r.size() == v.size(), what);
+    check(r.file().block_count() == (v.size() + block_size - 1) / block_size,
+          what);
+    std::vector<T> out(v.size(), v.front());  // year_month has no default
+                                              //   constructor
+    r.decode(0, v.size(), out.data());
+    for (std::size_t i = 0; i < v.size(); ++i)
+        check(traits::encode(out[i]) == traits::encode(v[i]), what);
+    std::vector<std::int64_t> raw(v.size());
+    r.decode_raw(0, v.size(), raw.data());
+    for (std::size_t i = 0; i < v.size(); ++i)
+        check(raw[i] == traits::encode(v[i]), what);
+    for (std::size_t pos = 0; pos < v.size(); pos += block_size / 2 + 1)
+    {
+        std::size_t n = std::min(block_size + 3, v.size() - pos);
+        r.decode_raw(pos, n, raw.data());
+        for (std::size_t i = 0; i < n; ++i)
+            check(raw[i] == traits::encode(v[pos+i]), what);
+    }
+}
+
+void
+check_round_trips()
+{
+    using namespace std::chrono;
+    std::mt19937_64 g(1);
+    std::vector<date> days_v;
+    date d = year(1999)/jan/day(1);
+    for (int i = 0; i < 2500; ++i, d += days(1))
+        days_v.push_back(d);  // 0 bit blocks
+    for (int i = 0; i < 3000; ++i)
+        days_v.push_back(date::from_day_number(12000000 + g() % 1000000));
+    for (std::size_t block_size : {1, 7, 1000, 4096})
+        round_trip(days_v, block_size, "round trip: date");
+
+    std::vector<year_month> ym;
+    for (int i = -30; i < 300; ++i)
+        ym.push_back(year(i * 97)/month(i % 12 < 0 ? i % 12 + 13 : i % 12 + 1));
+    round_trip(ym, 33, "round trip: year_month");
+
+    // Differences of the whole range of int64_t, which pack at 64 bits
+    std::vector<nanoseconds> ns;
+    for (int i = 0; i < 10000; ++i)
+        ns.push_back(nanoseconds(static_cast<std::int64_t>(g())));
+    ns.push_back(nanoseconds(INT64_MIN));
+    ns.push_back(nanoseconds(INT64_MAX));
+    ns.push_back(nanoseconds(INT64_MIN));
+    ns.push_back(nanoseconds(INT64_MAX));
+    for (std::size_t block_size : {2, 777, 4096})
+        round_trip(ns, block_size, "round trip: nanoseconds");
+
+    bool threw = false;
+    try
+    {
+        column_reader<microseconds> r(scratch);
+    }
+    catch (const bad_column_file&)
+    {
+        threw = true;
+    }
+    check(threw, "read as the wrong period");
+    threw = false;
+    try
+    {
+        column_reader<date> r(scratch);
+    }
+    catch (const bad_column_file&)
+    {
+        threw = true;
+    }
+    check(threw, "read as the wrong kind");
+    std::printf("column files: round trips ok\n");
+}
+
+// Cuts the file inside its last block and inside its header
+
+void
+check_cut_short()
+{
+    using namespace std::chrono;
+    std::vector<std::int64_t> v;
+    for (std::int64_t i = 0; i < 300; ++i)
+        v.push_back(12000000 + i * i);
+    std::remove(scratch);
+    {
+        column_writer<date> w(scratch, 100);
+        w.append_raw(v.data(), 200);
+    }
+    const std::size_t whole = file_size(scratch);
+    {
+        column_writer<date> w(scratch, 100);
+        w.append_raw(v.data() + 200, 100);
+    }
+    const std::size_t full = file_size(scratch);
+    std::vector<std::int64_t> out(v.size());
+    for (std::size_t n = whole; n < full; ++n)
+    {
+        std::remove(scratch);
+        {
+            column_writer<date> w(scratch, 100);
+            w.append_raw(v.data(), v.size());
+        }
+        cut(scratch, n);
+        check(column_reader<date>(scratch).size() == 200,
+              "cut short: partial block read");
+        {
+            column_writer<date> w(scratch, 100);
+            w.append_raw(v.data() + 200, 100);
+        }
+        column_reader<date> r(scratch);
+        check(r.size() == 300, "cut short: partial block kept by the writer");
+        r.decode_raw(0, 300, out.data());
+        check(out == v, "cut short: values lost");
+    }
+    cut(scratch, 20);
+    bool threw = false;
+    try
+    {
+        column_reader<date> r(scratch);
+    }
+    catch (const bad_column_file&)
+    {
+        threw = true;
+    }
+    check(threw, "cut short: header accepted");
+    std::printf("column files: cut short at each of %zu bytes ok\n",
+                full - whole);
+}
+
+// add_months as date arithmetic would do it, with eom resolving a day past
+// the end of the target month.  0 for a result outside the range of date
+// or an input that is not a day number.
+
+int
+month_end(int m, bool leap)
+{
+    static const unsigned char last[] = {31, 28, 31, 30, 31, 30,
+                                         31, 31, 30, 31, 30, 31};
+    return last[m-1] + (m == 2 && leap);
+}
+
+std::uint32_t
+shifted(std::uint32_t x, long long dm, std::chrono::end_of_month eom)
+{
+    using namespace std::chrono;
+    try
+    {
+        date d = date::from_day_number(x);
+        long long ym = int(d.year()) * 12LL + (d.month() - 1) + dm;
+        long long y = (ym >= 0 ? ym : ym - 11) / 12;
+        if (y < -32768 || y > 32767)
+            return 0;
+        int m = static_cast<int>(ym - y * 12) + 1;
+        date first = year(static_cast<int>(y))/month(m)/day(1);
+        int end = month_end(m, first.is_leap_year());
+        int dd = d.day();
+        bool was_last = dd == month_end(d.month(), d.is_leap_year());
+        if (dd <= end && !(eom == end_of_month::last_day && was_last))
+            return (first + days(dd - 1)).day_number();
+        if (eom == end_of_month::overflow)
+            return (first + days(dd - 1)).day_number();
+        return (first + days(end - 1)).day_number();
+    }
+    catch (const bad_date&)
+    {
+        return 0;
+    }
+}
+
+// Compares add_months, add_years and their parallel forms with shifted on
+// a mix of ordinary day numbers, the ends of the range of date, and values
+// that are not day numbers
+
+void
+check_add_months()
+{
+    using namespace std::chrono;
+    const std::uint32_t lo = (year(-32768)/jan/day(1)).day_number();
+    const std::uint32_t hi = (year(32767)/dec/day(31)).day_number();
+    std::mt19937 g(3);
+    std::vector<std::uint32_t> in(200000);
+    for (std::uint32_t& x : in)
+    {
+        unsigned r = g() % 100;
+        x = r == 0 ? g() : r == 1 ? lo + g() % 400 : r == 2 ? hi - g() % 400 :
+                                    lo + g() % (hi - lo + 1);
+    }
+    std::vector<std::uint32_t> out(in.size());
+    std::vector<std::uint32_t> par(in.size());
+    for (long long dm : {0LL, 1LL, -1LL, 11LL, 12LL, -13LL, 25LL, 1200LL,
+                         -1200LL, 786431LL, -786431LL, 2000000000LL,
+                         -2000000000LL})
+    {
+        for (end_of_month eom : {end_of_month::clamp, end_of_month::overflow,
+                                 end_of_month::last_day})
+        {
+            months m(static_cast<std::int32_t>(dm));
+            std::size_t bad = add_months(in.data(), out.data(), in.size(), m,
+                                         eom);
+            std::size_t zeros = 0;
+            for (std::size_t i = 0; i < in.size(); ++i)
+            {
+                check(out[i] == shifted(in[i], dm, eom),
+                      "add_months: differs from date arithmetic");
+                zeros += out[i] == 0;
+            }
+            check(bad == zeros, "add_months: wrong count out of range");
+            check(parallel_add_months(in.data(), par.data(), in.size(), m,
+                                      eom, 4) == bad && par == out,
+                  "parallel_add_months: differs from add_months");
+            if (dm % 12 == 0 && dm / 12 < 30000 && dm / 12 > -30000)
+            {
+                years y(static_cast<std::int32_t>(dm / 12));
+                check(add_years(in.data(), par.data(), in.size(), y, eom) ==
+                      bad && par == out, "add_years: differs from add_months");
+            }
+        }
+    }
+    // in place
+    par = in;
+    add_months(par.data(), par.data(), par.size(), months(7));
+    add_months(in.data(), out.data(), in.size(), months(7));
+    check(par == out, "add_months: in place differs");
+    std::printf("add_months: matches date arithmetic for each end_of_month\n");
+}
+
+void
+time_add_months(std::size_t n)
+{
+    using namespace std::chrono;
+    std::mt19937 g(3);
+    std::vector<std::uint32_t> in(n);
+    for (std::uint32_t& x : in)
+        x = 12000000 + g() % 1000000;
+    std::vector<std::uint32_t> out(n);
+    Clock::time_point t0 = Clock::now();
+    std::size_t bad = add_months(in.data(), out.data(), n, months(1));
+    Clock::time_point t1 = Clock::now();
+    bad += parallel_add_months(in.data(), out.data(), n, months(1));
+    Clock::time_point t2 = Clock::now();
+    std::vector<date> dv;
+    dv.reserve(n);
+    for (std::uint32_t x : in)
+        dv.push_back(date::from_day_number(x));
+    std::size_t thrown = 0;
+    Clock::time_point t3 = Clock::now();
+    for (date& d : dv)
+    {
+        try
+        {
+            d += months(1);
+        }
+        catch (const bad_date&)
+        {
+            ++thrown;
+        }
+    }
+    Clock::time_point t4 = Clock::now();
+    sink = out[n - 1] + dv[n - 1].day_number() + bad;
+    print("add_months", t1 - t0, n);
+    print("parallel_add_months", t2 - t1, n);
+    std::printf("%-36s %8.2f  (%.1f%% threw)\n", "date::operator+=(months)",
+                std::chrono::duration<double, std::nano>(t4 - t3).count() / n,
+                100.0 * thrown / n);
+}
+
+// Every column of a date_dimension against the date observers, and the ISO
+// year and week against strftime's %G and %V, over 1600-2400.  Then checks
+// the table survives save and map, and that load_or_build reuses a saved
+// table only when it covers the range asked for.
+
+void
+check_date_dimension()
+{
+    using namespace std::chrono;
+    const std::uint32_t first = (year(1600)/jan/day(1)).day_number();
+    const std::uint32_t last = (year(2400)/dec/day(31)).day_number();
+    date_dimension dd(first, last, 3);
+    check(dd.size() == last - first + 1, "date_dimension: size");
+    for (std::uint32_t x = first; x <= last; ++x)
+    {
+        const date d = date::from_day_number(x);
+        const std::size_t i = dd.index(x);
+        const int y = d.year();
+        check(dd.year()[i] == y && dd.month()[i] == d.month() &&
+              dd.day()[i] == d.day(), "date_dimension: year, month or day");
+        check(dd.weekday()[i] == d.weekday(), "date_dimension: weekday");
+        check(dd.is_leap_year()[i] == d.is_leap_year(),
+              "date_dimension: is_leap_year");
+        check(dd.quarter()[i] == (d.month() + 2) / 3,
+              "date_dimension: quarter");
+        const int yday = (d - year(y)/jan/day(1)).count();
+        check(dd.day_of_year()[i] == yday + 1, "date_dimension: day_of_year");
+        std::tm tm = {};
+        tm.tm_year = y - 1900;
+        tm.tm_yday = yday;
+        tm.tm_wday = d.weekday();
+        char iso[32];
+        std::strftime(iso, sizeof(iso), "%G %V", &tm);
+        int iso_year;
+        int iso_week;
+        check(std::sscanf(iso, "%d %d", &iso_year, &iso_week) == 2 &&
+              dd.iso_year()[i] == iso_year && dd.iso_week()[i] == iso_week,
+              "date_dimension: ISO year or week differs from strftime");
+    }
+    check(reinterpret_cast<std::uintptr_t>(dd.month()) % 64 == 0 &&
+          reinterpret_cast<std::uintptr_t>(dd.iso_week()) % 64 == 0,
+          "date_dimension: column not on a 64 byte boundary");
+
+    std::remove(scratch);
+    dd.save(scratch);
+    {
+        date_dimension m(scratch);
+        check(m.first() == first && m.last() == last &&
+              std::memcmp(m.year(), dd.year(), 2 * dd.size()) == 0 &&
+              std::memcmp(m.iso_week(), dd.iso_week(), dd.size()) == 0,
+              "date_dimension: mapped table differs");
+        check(reinterpret_cast<std::uintptr_t>(m.iso_week()) % 64 == 0,
+              "date_dimension: mapped column not on a 64 byte boundary");
+    }
+    check(date_dimension::load_or_build(scratch, first + 10,
+                                        last - 10).first() == first,
+          "date_dimension: covering table not reused");
+    date_dimension wider = date_dimension::load_or_build(scratch, first - 10,
+                                                         last);
+    check(wider.first() == first - 10 && wider.index(first) == 10 &&
+          wider.year()[10] == 1600, "date_dimension: table not rebuilt");
+    cut(scratch, 20);
+    bool threw = false;
+    try
+    {
+        date_dimension m(scratch);
+    }
+    catch (const bad_column_file&)
+    {
+        threw = true;
+    }
+    check(threw, "date_dimension: cut short table accepted");
+    std::printf("date_dimension: matches date and strftime for 1600-2400\n");
+}
+
+void
+time_columns(std::size_t n)
+{
+    using namespace std::chrono;
+    std::vector<std::int64_t> v(n);
+    std::mt19937 g(1);
+    std::int64_t x = 12000000;
+    for (std::int64_t& e : v)
+        e = x += g() % 3;
+    std::remove(scratch);
+    Clock::time_point t0 = Clock::now();
+    {
+        column_writer<date> w(scratch);
+        w.append_raw(v.data(), v.size());
+    }
+    Clock::time_point t1 = Clock::now();
+    column_reader<date> r(scratch);
+    std::vector<std::uint32_t> out(n);
+    Clock::time_point t2 = Clock::now();
+    r.decode_raw(0, n, out.data());
+    Clock::time_point t3 = Clock::now();
+    check(out[n / 2] == v[n / 2], "decode timing: wrong value");
+    sink = out[n - 1];
+    print("column write, day numbers", t1 - t0, n);
+    print("column decode to uint32_t", t3 - t2, n);
+}
+
+void
+time_date_dimension()
+{
+    using namespace std::chrono;
+    const std::uint32_t first = (year(1900)/jan/day(1)).day_number();
+    const std::uint32_t last = (year(2099)/dec/day(31)).day_number();
+    Clock::time_point t0 = Clock::now();
+    date_dimension dd(first, last);
+    Clock::time_point t1 = Clock::now();
+    std::remove(scratch);
+    dd.save(scratch);
+    Clock::time_point t2 = Clock::now();
+    date_dimension m(scratch);
+    Clock::time_point t3 = Clock::now();
+    sink = m.iso_week()[100] + dd.day()[100];
+    print("date_dimension build, 1900-2099", t1 - t0, dd.size());
+    std::printf("%-36s %8.2f us\n", "date_dimension map, 1900-2099",
+                std::chrono::duration<double, std::micro>(t3 - t2).count());
+}
+
+}  // unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::size_t n = 10000000;
+    if (argc > 1)
+        n = std::strtoul(argv[1], nullptr, 10);
+    check_round_trips();
+    check_cut_short();
+    check_add_months();
+    check_date_dimension();
+    std::printf("\n%-36s %8s\n", "date_columns", "ns/value");
+    time_columns(n);
+    time_add_months(n);
+    time_date_dimension();
+    std::remove(scratch);
+}
@@ -0,0 +1,131 @@
+//  chrono_io_bench.cpp
+//
+//  (C) Copyright Howard Hinnant
+//  Use, modification and distribution are subject to the Boost Software License,
+//  Version 1.0. (See accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt).
+
+// Timings for writing system_clock::time_points.
+//
+// to_chars keeps, per thread, the text of the last second it wrote.  The
+// "hit" runs stay within one second, so every call but the first copies
+// that text and renders only the fractional digits.  One hit run steps a
+// microsecond per call; the other writes each microsecond 8 times over,
+// as a burst of log lines would.  The "miss" runs step a whole second per
+// call, so every call converts the time with gmtime_r or localtime_r.
+// operator<< into a reused std::ostringstream is timed for comparison.
+// Reported is ns per time_point written.
+//
+//   c++ -std=c++14 -O2 chrono_io_bench.cpp
+//   ./a.out [time_points per run]
+
+#include "chrono_io"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::system_clock::time_point time_point;
+
+volatile char sink;  // keeps results alive
+
+// The i-th time_point of a run, starting from a whole second t0
+
+struct same_second
+{
+    time_point
+    operator()(time_point t0, long i) const
+    {
+        return t0 + std::chrono::microseconds(i & 0x7FFFF);  // < 1 s
+    }
+};
+
+struct same_microsecond
+{
+    time_point
+    operator()(time_point t0, long i) const
+    {
+        return t0 + std::chrono::microseconds((i / 8) & 0x7FFFF);
+    }
+};
+
+struct next_second
+{
+    time_point
+    operator()(time_point t0, long i) const
+    {
+        return t0 + std::chrono::seconds(i) +
+                    std::chrono::microseconds(i & 0x7FFFF);
+    }
+};
+
+void
+print(const char* what, Clock::duration d, long n)
+{
+    std::printf("%-36s %8.1f\n", what,
+                std::chrono::duration<double, std::nano>(d).count() / n);
+}
+
+template <class Step>
+void
+time_to_chars(const char* what, Step step, int tz, time_point t0, long n)
+{
+    char buf[64];
+    char c = 0;
+    Clock::time_point t1 = Clock::now();
+    for (long i = 0; i < n; ++i)
+    {
+        std::chrono::to_chars_result<char> r =
+            std::chrono::to_chars(buf, buf + sizeof(buf), step(t0, i), tz);
+        c ^= r.ptr[-9];
+    }
+    Clock::time_point t2 = Clock::now();
+    sink = c;
+    print(what, t2 - t1, n);
+}
+
+template <class Step>
+void
+time_stream(const char* what, Step step, time_point t0, long n)
+{
+    std::ostringstream os;
+    char c = 0;
+    Clock::time_point t1 = Clock::now();
+    for (long i = 0; i < n; ++i)
+    {
+        os.str(std::string());
+        os << step(t0, i);
+        c ^= os.str()[0];
+    }
+    Clock::time_point t2 = Clock::now();
+    sink = c;
+    print(what, t2 - t1, n);
+}
+
+}  // unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    long n = 10000000;
+    if (argc > 1)
+        n = std::strtol(argv[1], nullptr, 10);
+    // Start on a whole second so that a "hit" run never leaves it
+    using std::chrono::utc;
+    using std::chrono::local;
+    time_point t0 = std::chrono::time_point_cast<std::chrono::seconds>(
+                                              std::chrono::system_clock::now());
+    std::printf("%-36s %8s\n", "system_clock::time_point", "ns");
+    time_to_chars("to_chars utc, hit", same_second(), utc, t0, n);
+    time_to_chars("to_chars local, hit", same_second(), local, t0, n);
+    time_to_chars("to_chars utc, hit, 8 per us", same_microsecond(), utc, t0,
+                  n);
+    time_to_chars("to_chars utc, miss", next_second(), utc, t0, n / 10);
+    time_to_chars("to_chars local, miss", next_second(), local, t0, n / 10);
+    time_stream("operator<<, same second", same_second(), t0, n / 10);
+    time_stream("operator<<, next second", next_second(), t0, n / 10);
+}
@@ -0,0 +1,337 @@
+#ifndef MAPPED_ARENA_H
+#define MAPPED_ARENA_H
+
+
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 Howard Hinnant
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// mapped_arena is arena with its N byte buffer mapped from the operating
+// system rather than embedded in the object, for large per-thread scratch
+// space where page size and NUMA placement matter.  Options, or'ed
+// together and passed to the constructor:
+//
+//   mapped_options::huge_pages  map with MAP_HUGETLB.  If no huge pages are
+//                               reserved, fall back to normal pages with
+//                               transparent huge pages requested.
+//   mapped_options::thp         request transparent huge pages only
+//                               (madvise MADV_HUGEPAGE).  The buffer is
+//                               aligned to the huge page size to make that
+//                               possible.
+//   mapped_options::local_node  prefer the NUMA node of the constructing
+//                               thread (mbind MPOL_PREFERRED).  The kernel
+//                               may still use another node under memory
+//                               pressure instead of failing.
+//   mapped_options::prefault    fault in every page in the constructor,
+//                               after the node policy is set, so the hot
+//                               path takes no first-touch faults.
+//
+// Options the platform lacks are ignored.  huge_pages() reports whether
+// huge pages were mapped or transparent huge pages accepted, and node()
+// the preferred node, or -1.  Without mmap the buffer comes from ::operator new.
+// Otherwise mapped_arena behaves as arena, including the fallback to
+// ::operator new when full and mark()/rollback(), and works with
+// short_alloc through mapped_short_alloc:
+//
+//   mapped_arena<64 << 20> a(mapped_options::huge_pages |
+//                            mapped_options::local_node |
+//                            mapped_options::prefault);
+//   std::vector<int, mapped_short_alloc<int, 64 << 20>> v{a};
+
+#include "short_alloc.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/mman.h>
+#  include <unistd.h>
+#  define MAPPED_ARENA_MMAP 1
+#  ifdef __linux__
+#    include <sys/syscall.h>
+#  endif
+#endif
+
+struct mapped_options
+{
+    enum : unsigned
+    {
+        huge_pages = 1,
+        thp        = 2,
+        local_node = 4,
+        prefault   = 8
+    };
+};
+
+// The mapping behind a mapped_arena
+
+class mapped_region
+{
+    char*       p_;
+    std::size_t len_;
+    bool        huge_;
+    int         node_;
+
+    static const std::size_t huge_page_size = std::size_t(2) << 20;
+
+public:
+    mapped_region(std::size_t n, unsigned options);
+    ~mapped_region();
+    mapped_region(const mapped_region&) = delete;
+    mapped_region& operator=(const mapped_region&) = delete;
+
+    char* data() const noexcept {return p_;}
+    std::size_t size() const noexcept {return len_;}
+    bool huge_pages() const noexcept {return huge_;}
+    int node() const noexcept {return node_;}
+
+private:
+    static
+    std::size_t
+    round_up(std::size_t n, std::size_t a) noexcept
+        {return (n + (a-1)) & ~(a-1);}
+
+    void map(std::size_t n, unsigned options);
+    void bind_local_node() noexcept;
+    void fault_in() noexcept;
+};
+
+inline
+mapped_region::mapped_region(std::size_t n, unsigned options)
+    : p_(nullptr), len_(0), huge_(false), node_(-1)
+{
+#if MAPPED_ARENA_MMAP
+    map(n, options);
+    if (options & mapped_options::local_node)
+        bind_local_node();
+    if (options & mapped_options::prefault)
+        fault_in();
+#else
+    (void)options;
+    len_ = n;
+    p_ = static_cast<char*>(::operator new(n));
+#endif
+}
+
+inline
+mapped_region::~mapped_region()
+{
+    SHORT_ALLOC_UNPOISON(p_, len_);
+#if MAPPED_ARENA_MMAP
+    munmap(p_, len_);
+#else
+    ::operator delete(p_);
+#endif
+}
+
+#if MAPPED_ARENA_MMAP
+
+inline
+void
+mapped_region::map(std::size_t n, unsigned options)
+{
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const int prot = PROT_READ | PROT_WRITE;
+    const int flags = MAP_PRIVATE | MAP_ANON;
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (options & mapped_options::huge_pages)
+    {
+        len_ = round_up(n, huge_page_size);
+        p = mmap(nullptr, len_, prot, flags | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            huge_ = true;
+            p_ = static_cast<char*>(p);
+            return;
+        }
+        options |= mapped_options::thp;
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if ((options & (mapped_options::huge_pages | mapped_options::thp)) &&
+        n >= huge_page_size)
+    {
+        // Map a huge page extra and trim, so the buffer starts on a huge
+        // page boundary.
+        len_ = round_up(n, huge_page_size);
+        p = mmap(nullptr, len_ + huge_page_size, prot, flags, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+        char* b = static_cast<char*>(p);
+        char* a = reinterpret_cast<char*>(round_up(std::uintptr_t(b), huge_page_size));
+        if (a != b)
+            munmap(b, static_cast<std::size_t>(a - b));
+        munmap(a + len_, static_cast<std::size_t>(b + huge_page_size - a));
+        p_ = a;
+        huge_ = madvise(p_, len_, MADV_HUGEPAGE) == 0;
+        return;
+    }
+#endif
+    len_ = round_up(n, page);
+    p = mmap(nullptr, len_, prot, flags, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::bad_alloc();
+    p_ = static_cast<char*>(p);
+}
+
+inline
+void
+mapped_region::bind_local_node() noexcept
+{
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+    const int mpol_preferred = 1;
+    unsigned cpu;
+    unsigned node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+        return;
+    const unsigned bits = 8 * sizeof(unsigned long);
+    unsigned long mask[1024 / bits] = {};
+    if (node >= 1024)
+        return;
+    mask[node / bits] = 1ul << (node % bits);
+    if (syscall(SYS_mbind, p_, len_, mpol_preferred, mask,
+                sizeof(mask) * 8 + 1, 0u) == 0)
+        node_ = static_cast<int>(node);
+#endif
+}
+
+inline
+void
+mapped_region::fault_in() noexcept
+{
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(p_, len_, MADV_POPULATE_WRITE) == 0)
+        return;
+#endif
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    volatile char* p = p_;
+    for (std::size_t i = 0; i < len_; i += page)
+        p[i] = 0;
+}
+
+#endif  // MAPPED_ARENA_MMAP
+
+template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
+class mapped_arena
+{
+    mapped_region region_;
+    char*         buf_;
+    char*         ptr_;
+
+public:
+    class marker
+    {
+        char* ptr_;
+
+        explicit marker(char* p) noexcept : ptr_(p) {}
+        friend class mapped_arena;
+    };
+
+    explicit mapped_arena(unsigned options = 0)
+        : region_(N, options), buf_(region_.data()), ptr_(buf_) {}
+    ~mapped_arena() {ptr_ = nullptr;}
+    mapped_arena(const mapped_arena&) = delete;
+    mapped_arena& operator=(const mapped_arena&) = delete;
+
+    template <std::size_t ReqAlign> char* allocate(std::size_t n);
+    void deallocate(char* p, std::size_t n) noexcept;
+
+    static constexpr std::size_t size() noexcept {return N;}
+    std::size_t used() const noexcept {return static_cast<std::size_t>(ptr_ - buf_);}
+    void reset() noexcept {SHORT_ALLOC_POISON(buf_, used()); ptr_ = buf_;}
+
+    marker mark() const noexcept {return marker(ptr_);}
+    void rollback(marker m) noexcept;
+
+    bool huge_pages() const noexcept {return region_.huge_pages();}
+    int node() const noexcept {return region_.node();}
+
+private:
+    static
+    std::size_t
+    align_up(std::size_t n) noexcept
+        {return (n + (alignment-1)) & ~(alignment-1);}
+
+    bool
+    pointer_in_buffer(char* p) noexcept
+    {
+        return std::uintptr_t(buf_) <= std::uintptr_t(p) &&
+               std::uintptr_t(p) <= std::uintptr_t(buf_) + N;
+    }
+};
+
+template <std::size_t N, std::size_t alignment>
+template <std::size_t ReqAlign>
+char*
+mapped_arena<N, alignment>::allocate(std::size_t n)
+{
+    static_assert(ReqAlign <= alignment, "alignment is too small for this arena");
+    assert(pointer_in_buffer(ptr_) && "short_alloc has outlived arena");
+    auto const aligned_n = align_up(n);
+    if (static_cast<std::size_t>(buf_ + N - ptr_) >= aligned_n)
+    {
+        char* r = ptr_;
+        ptr_ += aligned_n;
+        SHORT_ALLOC_UNPOISON(r, aligned_n);
+        return r;
+    }
+
+    static_assert(alignment <= alignof(std::max_align_t), "you've chosen an "
+                  "alignment that is larger than alignof(std::max_align_t), and "
+                  "cannot be guaranteed by normal operator new");
+    return static_cast<char*>(::operator new(n));
+}
+
+template <std::size_t N, std::size_t alignment>
+void
+mapped_arena<N, alignment>::deallocate(char* p, std::size_t n) noexcept
+{
+    assert(pointer_in_buffer(ptr_) && "short_alloc has outlived arena");
+    if (pointer_in_buffer(p))
+    {
+        n = align_up(n);
+        if (p + n == ptr_)
+            ptr_ = p;
+    }
+    else
+        ::operator delete(p);
+}
+
+template <std::size_t N, std::size_t alignment>
+void
+mapped_arena<N, alignment>::rollback(marker m) noexcept
+{
+    assert(pointer_in_buffer(m.ptr_) && "marker is not from this arena");
+    if (m.ptr_ < ptr_)
+    {
+        SHORT_ALLOC_POISON(m.ptr_, static_cast<std::size_t>(ptr_ - m.ptr_));
+        ptr_ = m.ptr_;
+    }
+}
+
+// short_alloc over a mapped_arena
+
+template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+using mapped_short_alloc = short_alloc<T, N, Align, mapped_arena<N, Align>>;
+
+#endif  // MAPPED_ARENA_H
@@ -2,7 +2,12 @@
 // Software License, Version 1.0. (see http://www.boost.org/LICENSE_1_0.txt)
 
 #include <shared_mutex>
+#include <cassert>
+#include <cstdio>
 #include <thread>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 namespace ting
 {
@@ -44,6 +49,41 @@ shared_mutex::try_lock()
     return false;
 }
 
+bool
+shared_mutex::__try_lock_until(std::chrono::steady_clock::time_point abs_time)
+{
+    std::unique_lock<mutex_t> lk(mut_);
+    if (state_ & write_entered_)
+    {
+        while (true)
+        {
+            std::cv_status status = gate1_.wait_until(lk, abs_time);
+            if ((state_ & write_entered_) == 0)
+                break;
+            if (status == std::cv_status::timeout)
+                return false;
+        }
+    }
+    state_ |= write_entered_;
+    if (state_ & n_readers_)
+    {
+        while (true)
+        {
+            std::cv_status status = gate2_.wait_until(lk, abs_time);
+            if ((state_ & n_readers_) == 0)
+                break;
+            if (status == std::cv_status::timeout)
+            {
+                state_ &= ~write_entered_;
+                // threads held back by write_entered_ may now enter
+                gate1_.notify_all();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 void
 shared_mutex::unlock()
 {
@@ -80,6 +120,29 @@ shared_mutex::try_lock_shared()
     return false;
 }
 
+bool
+shared_mutex::__try_lock_shared_until(
+                                 std::chrono::steady_clock::time_point abs_time)
+{
+    std::unique_lock<mutex_t> lk(mut_);
+    if ((state_ & write_entered_) || (state_ & n_readers_) == n_readers_)
+    {
+        while (true)
+        {
+            std::cv_status status = gate1_.wait_until(lk, abs_time);
+            if ((state_ & write_entered_) == 0 &&
+                                             (state_ & n_readers_) < n_readers_)
+                break;
+            if (status == std::cv_status::timeout)
+                return false;
+        }
+    }
+    count_t num_readers = (state_ & n_readers_) + 1;
+    state_ &= ~n_readers_;
+    state_ |= num_readers;
+    return true;
+}
+
 void
 shared_mutex::unlock_shared()
 {
@@ -113,37 +176,157 @@ upgrade_mutex::~upgrade_mutex()
     std::lock_guard<mutex_t> _(mut_);
 }
 
+// Moves state_ from s to next(s) if ready(s) holds, retrying only while
+// the CAS fails and ready still holds.  The first CAS is made against the
+// caller's guess at the state, which saves loading state_ beforehand when
+// the guess is right and costs nothing when it is wrong: the failed CAS
+// loads state_.
+
+template <class Ready, class Next>
+inline
+bool
+upgrade_mutex::__try_set(count_t s, Ready ready, Next next)
+{
+    while (ready(s))
+    {
+        if (state_.compare_exchange_weak(s, next(s), std::memory_order_acquire,
+                                                     std::memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+// Waits on gate until ready(s) holds, then moves state_ from s to next(s).
+// The waiting bit is set under mut_, so whoever clears it and then takes
+// mut_ to notify cannot do so between the check and the wait.  Returns
+// false if abs_time passes first.
+
+template <class Ready, class Next>
+bool
+upgrade_mutex::__wait(cond_t& gate, count_t waiting, Ready ready, Next next,
+                      const std::chrono::steady_clock::time_point* abs_time)
+{
+    std::unique_lock<mutex_t> lk(mut_);
+    bool timed_out = false;
+    count_t s = state_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        if (ready(s))
+        {
+            if (state_.compare_exchange_weak(s, next(s),
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+                return true;
+        }
+        else if (timed_out)
+            return false;
+        else if ((s & waiting) ||
+                 state_.compare_exchange_weak(s, s | waiting,
+                                              std::memory_order_relaxed))
+        {
+            if (abs_time == nullptr)
+                gate.wait(lk);
+            else
+                timed_out = gate.wait_until(lk, *abs_time) ==
+                                                      std::cv_status::timeout;
+            s = state_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// The waiting bits of the gates that the change from s to n may open.  A
+// thread waits only while what it waits for is false, and only a release
+// makes that true, so a gate needs waking only when one of the conditions
+// its waiters wait for goes from false to true.  Readers leaving one by
+// one while upgrade ownership is held thus wake nobody on gate1, and wake
+// gate2 only as the last reader besides the upgrader leaves.
+//
+// gate1: lock, lock_shared and lock_upgrade (__can_lock, __can_lock_shared)
+// gate2: the writer waiting for readers to leave (__drained), and the
+//        timed conversions (__sole_reader, __can_lock, __sole_upgrader)
+
+upgrade_mutex::count_t
+upgrade_mutex::__opened(count_t s, count_t n)
+{
+    count_t r = 0;
+    if ((s & gate1_waiting_) &&
+        ((!__can_lock(s) && __can_lock(n)) ||
+         (!__can_lock_shared(s) && __can_lock_shared(n))))
+        r |= gate1_waiting_;
+    if ((s & gate2_waiting_) &&
+        ((!__drained(s) && __drained(n)) ||
+         (!__sole_reader(s) && __sole_reader(n)) ||
+         (!__can_lock(s) && __can_lock(n)) ||
+         (!__sole_upgrader(s) && __sole_upgrader(n))))
+        r |= gate2_waiting_;
+    return r;
+}
+
+// Moves state_ from s to next(s) for a change that gives up ownership and
+// wakes the waiters that may now proceed.  The waiting bits of the gates
+// not woken stay set.  s starts as a guess, as for __try_set.
+
+template <class Next>
+void
+upgrade_mutex::__release(count_t s, Next next)
+{
+    count_t n;
+    count_t wake;
+    do
+    {
+        n = next(s);
+        wake = __opened(s, n);
+    } while (!state_.compare_exchange_weak(s, n & ~wake,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed));
+    if (wake)
+    {
+        std::lock_guard<mutex_t> _(mut_);
+        if (wake & gate1_waiting_)
+            gate1_.notify_all();
+        if (wake & gate2_waiting_)
+            gate2_.notify_all();
+    }
+}
+
 // Exclusive ownership
 
 void
 upgrade_mutex::lock()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    while (state_ & (write_entered_ | upgradable_entered_))
-        gate1_.wait(lk);
-    state_ |= write_entered_;
-    while (state_ & n_readers_)
-        gate2_.wait(lk);
+    if (!__try_set(0, __can_lock, __set_write))
+        __wait(gate1_, gate1_waiting_, __can_lock, __set_write, nullptr);
+    if (state_.load(std::memory_order_acquire) & n_readers_)
+        __wait(gate2_, gate2_waiting_, __no_readers, __unchanged, nullptr);
 }
 
 bool
 upgrade_mutex::try_lock()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    if (state_ == 0)
+    return __try_set(0, __free, __set_write);
+}
+
+bool
+upgrade_mutex::__try_lock_until(std::chrono::steady_clock::time_point abs_time)
+{
+    if (!__try_set(0, __can_lock, __set_write) &&
+        !__wait(gate1_, gate1_waiting_, __can_lock, __set_write, &abs_time))
+        return false;
+    if ((state_.load(std::memory_order_acquire) & n_readers_) &&
+        !__wait(gate2_, gate2_waiting_, __no_readers, __unchanged, &abs_time))
     {
-        state_ = write_entered_;
-        return true;
+        // threads held back by write_entered_ may now enter
+        __release(state_.load(std::memory_order_relaxed),
+                  [](count_t s) {return s & ~write_entered_;});
+        return false;
     }
-    return false;
+    return true;
 }
 
 void
 upgrade_mutex::unlock()
 {
-    std::lock_guard<mutex_t> _(mut_);
-    state_ = 0;
-    gate1_.notify_all();
+    __release(write_entered_, [](count_t s) {return s & waiting_;});
 }
 
 // Shared ownership
@@ -151,46 +334,30 @@ upgrade_mutex::unlock()
 void
 upgrade_mutex::lock_shared()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    while ((state_ & write_entered_) || (state_ & n_readers_) == n_readers_)
-        gate1_.wait(lk);
-    count_t num_readers = (state_ & n_readers_) + 1;
-    state_ &= ~n_readers_;
-    state_ |= num_readers;
+    if (!__try_set(0, __can_lock_shared, __add_reader))
+        __wait(gate1_, gate1_waiting_, __can_lock_shared, __add_reader,
+               nullptr);
 }
 
 bool
 upgrade_mutex::try_lock_shared()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    count_t num_readers = state_ & n_readers_;
-    if (!(state_ & write_entered_) && num_readers != n_readers_)
-    {
-        ++num_readers;
-        state_ &= ~n_readers_;
-        state_ |= num_readers;
-        return true;
-    }
-    return false;
+    return __try_set(0, __can_lock_shared, __add_reader);
+}
+
+bool
+upgrade_mutex::__try_lock_shared_until(
+                                 std::chrono::steady_clock::time_point abs_time)
+{
+    return __try_set(0, __can_lock_shared, __add_reader) ||
+           __wait(gate1_, gate1_waiting_, __can_lock_shared, __add_reader,
+                  &abs_time);
 }
 
 void
 upgrade_mutex::unlock_shared()
 {
-    std::lock_guard<mutex_t> _(mut_);
-    count_t num_readers = (state_ & n_readers_) - 1;
-    state_ &= ~n_readers_;
-    state_ |= num_readers;
-    if (state_ & write_entered_)
-    {
-        if (num_readers == 0)
-            gate2_.notify_one();
-    }
-    else
-    {
-        if (num_readers == n_readers_ - 1)
-            gate1_.notify_one();
-    }
+    __release(1, [](count_t s) {return s - 1;});
 }
 
 // Upgrade ownership
@@ -198,41 +365,31 @@ upgrade_mutex::unlock_shared()
 void
 upgrade_mutex::lock_upgrade()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    while ((state_ & (write_entered_ | upgradable_entered_)) || 
-           (state_ & n_readers_) == n_readers_)
-        gate1_.wait(lk);
-    count_t num_readers = (state_ & n_readers_) + 1;
-    state_ &= ~n_readers_;
-    state_ |= upgradable_entered_ | num_readers;
+    if (!__try_set(0, __can_lock_upgrade, __add_upgrader))
+        __wait(gate1_, gate1_waiting_, __can_lock_upgrade, __add_upgrader,
+               nullptr);
 }
 
 bool
 upgrade_mutex::try_lock_upgrade()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    count_t num_readers = state_ & n_readers_;
-    if (!(state_ & (write_entered_ | upgradable_entered_))
-        && num_readers != n_readers_)
-    {
-        ++num_readers;
-        state_ &= ~n_readers_;
-        state_ |= upgradable_entered_ | num_readers;
-        return true;
-    }
-    return false;
+    return __try_set(0, __can_lock_upgrade, __add_upgrader);
+}
+
+bool
+upgrade_mutex::__try_lock_upgrade_until(
+                                 std::chrono::steady_clock::time_point abs_time)
+{
+    return __try_set(0, __can_lock_upgrade, __add_upgrader) ||
+           __wait(gate1_, gate1_waiting_, __can_lock_upgrade, __add_upgrader,
+                  &abs_time);
 }
 
 void
 upgrade_mutex::unlock_upgrade()
 {
-    {
-        std::lock_guard<mutex_t> _(mut_);
-        count_t num_readers = (state_ & n_readers_) - 1;
-        state_ &= ~(upgradable_entered_ | n_readers_);
-        state_ |= num_readers;
-    }
-    gate1_.notify_all();
+    __release(upgradable_entered_ | 1,
+              [](count_t s) {return (s - 1) & ~upgradable_entered_;});
 }
 
 // Shared <-> Exclusive
@@ -240,23 +397,22 @@ upgrade_mutex::unlock_upgrade()
 bool
 upgrade_mutex::try_unlock_shared_and_lock()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    if (state_ == 1)
-    {
-        state_ = write_entered_;
-        return true;
-    }
-    return false;
+    return __try_set(1, __sole_reader, __only_write);
+}
+
+bool
+upgrade_mutex::__try_unlock_shared_and_lock_until(
+                                 std::chrono::steady_clock::time_point abs_time)
+{
+    return __try_set(1, __sole_reader, __only_write) ||
+           __wait(gate2_, gate2_waiting_, __sole_reader, __only_write,
+                  &abs_time);
 }
 
 void
 upgrade_mutex::unlock_and_lock_shared()
 {
-    {
-        std::lock_guard<mutex_t> _(mut_);
-        state_ = 1;
-    }
-    gate1_.notify_all();
+    __release(write_entered_, [](count_t s) {return (s & waiting_) | 1;});
 }
 
 // Shared <-> Upgrade
@@ -264,58 +420,530 @@ upgrade_mutex::unlock_and_lock_shared()
 bool
 upgrade_mutex::try_unlock_shared_and_lock_upgrade()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    if (!(state_ & (write_entered_ | upgradable_entered_)))
-    {
-        state_ |= upgradable_entered_;
-        return true;
-    }
-    return false;
+    return __try_set(1, __can_lock, __set_upgrade);
+}
+
+bool
+upgrade_mutex::__try_unlock_shared_and_lock_upgrade_until(
+                                 std::chrono::steady_clock::time_point abs_time)
+{
+    return __try_set(1, __can_lock, __set_upgrade) ||
+           __wait(gate2_, gate2_waiting_, __can_lock, __set_upgrade, &abs_time);
 }
 
 void
 upgrade_mutex::unlock_upgrade_and_lock_shared()
 {
-    {
-        std::lock_guard<mutex_t> _(mut_);
-        state_ &= ~upgradable_entered_;
-    }
-    gate1_.notify_all();
+    __release(upgradable_entered_ | 1,
+              [](count_t s) {return s & ~upgradable_entered_;});
 }
 
 // Upgrade <-> Exclusive
 
+// Claims write_entered_ at once, which keeps new readers out, and then
+// waits for the remaining readers to leave.  Nobody waiting can proceed
+// after this change, so there is nobody to wake.
+
 void
 upgrade_mutex::unlock_upgrade_and_lock()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    count_t num_readers = (state_ & n_readers_) - 1;
-    state_ &= ~(upgradable_entered_ | n_readers_);
-    state_ |= write_entered_ | num_readers;
-    while (state_ & n_readers_)
-        gate2_.wait(lk);
+    count_t s = upgradable_entered_ | 1;
+    while (!state_.compare_exchange_weak(s,
+                              ((s - 1) & ~upgradable_entered_) | write_entered_,
+                              std::memory_order_acquire,
+                              std::memory_order_relaxed))
+        ;
+    if ((s & n_readers_) != 1)
+        __wait(gate2_, gate2_waiting_, __no_readers, __unchanged, nullptr);
 }
 
 bool
 upgrade_mutex::try_unlock_upgrade_and_lock()
 {
-    std::unique_lock<mutex_t> lk(mut_);
-    if (state_ == (upgradable_entered_ | 1))
+    return __try_set(upgradable_entered_ | 1, __sole_upgrader, __only_write);
+}
+
+bool
+upgrade_mutex::__try_unlock_upgrade_and_lock_until(
+                                 std::chrono::steady_clock::time_point abs_time)
+{
+    return __try_set(upgradable_entered_ | 1, __no_other_readers,
+                     __only_write) ||
+           __wait(gate2_, gate2_waiting_, __no_other_readers, __only_write,
+                  &abs_time);
+}
+
+void
+upgrade_mutex::unlock_and_lock_upgrade()
+{
+    __release(write_entered_,
+              [](count_t s) {return (s & waiting_) | upgradable_entered_ | 1;});
+}
+
+// cohort_upgrade_mutex
+
+namespace
+{
+
+// Number of NUMA nodes the system may have, at least 1
+
+unsigned
+numa_node_count()
+{
+    unsigned n = 1;
+#ifdef __linux__
+    // a list such as "0" or "0-3"
+    if (std::FILE* f = std::fopen("/sys/devices/system/node/possible", "r"))
     {
-        state_ = write_entered_;
-        return true;
+        unsigned first;
+        unsigned last;
+        int k = std::fscanf(f, "%u-%u", &first, &last);
+        if (k == 2)
+            n = last + 1;
+        else if (k == 1)
+            n = first + 1;
+        std::fclose(f);
     }
-    return false;
+#endif
+    return n;
+}
+
+thread_local int this_thread_node = -1;
+
+unsigned
+current_node()
+{
+    if (this_thread_node < 0)
+    {
+        this_thread_node = 0;
+#if defined(__linux__) && defined(SYS_getcpu)
+        unsigned cpu;
+        unsigned node;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+            this_thread_node = static_cast<int>(node);
+#endif
+    }
+    return static_cast<unsigned>(this_thread_node);
+}
+
+}  // unnamed namespace
+
+cohort_upgrade_mutex::cohort_upgrade_mutex(unsigned max_batch, unsigned nodes)
+    : holder_(-1),
+      token_node_(0),
+      n_nodes_(nodes != 0 ? nodes : numa_node_count()),
+      max_batch_(max_batch),
+      nodes_(new __cohort_node[n_nodes_])
+{
+}
+
+cohort_upgrade_mutex::~cohort_upgrade_mutex()
+{
+    std::lock_guard<mutex_t> _(cmut_);
 }
 
 void
-upgrade_mutex::unlock_and_lock_upgrade()
+cohort_upgrade_mutex::set_this_thread_node(unsigned node)
+{
+    this_thread_node = static_cast<int>(node);
+}
+
+unsigned
+cohort_upgrade_mutex::__node_index() const
+{
+    return current_node() % n_nodes_;
+}
+
+// Blocks until the calling thread holds the token, or until *abs_time if
+// abs_time is not null.  exclusive reports how the inner mutex is held.
+
+bool
+cohort_upgrade_mutex::__acquire(const time_point* abs_time, bool& exclusive)
 {
+    unsigned i = __node_index();
+    __cohort_node& n = nodes_[i];
+    std::unique_lock<mutex_t> lk(n.mut_);
+    ++n.waiting_;
+    while (true)
     {
-        std::lock_guard<mutex_t> _(mut_);
-        state_ = upgradable_entered_ | 1;
+        if (n.passed_)
+        {
+            n.passed_ = false;
+            n.owned_ = true;
+            --n.waiting_;
+            exclusive = n.passed_exclusive_;
+            token_node_ = i;
+            return true;
+        }
+        if (!n.owned_ && !n.requested_)
+        {
+            // Take the token if no node holds it, else queue this node
+            n.requested_ = true;
+            lk.unlock();
+            bool got = false;
+            {
+                std::lock_guard<mutex_t> _(cmut_);
+                if (holder_ < 0)
+                {
+                    // nobody else holds upgrade or exclusive ownership
+                    global_.lock_upgrade();
+                    holder_ = static_cast<int>(i);
+                    got = true;
+                }
+                else
+                    n.wants_ = true;
+            }
+            lk.lock();
+            if (got)
+            {
+                n.requested_ = false;
+                n.owned_ = true;
+                n.batch_ = 0;
+                --n.waiting_;
+                exclusive = false;
+                token_node_ = i;
+                return true;
+            }
+            continue;
+        }
+        if (abs_time == nullptr)
+            n.gate_.wait(lk);
+        else if (n.gate_.wait_until(lk, *abs_time) == std::cv_status::timeout &&
+                 !n.passed_)
+        {
+            // A queued request stays; the token skips a node nobody waits in.
+            --n.waiting_;
+            return false;
+        }
     }
-    gate1_.notify_all();
+}
+
+// Takes the token without blocking.  Ends with the inner mutex held
+// exclusively if exclusive, else in upgrade mode.
+
+bool
+cohort_upgrade_mutex::__try_acquire(bool exclusive)
+{
+    unsigned i = __node_index();
+    __cohort_node& n = nodes_[i];
+    {
+        std::lock_guard<mutex_t> _(n.mut_);
+        if (n.passed_)
+        {
+            if (n.passed_exclusive_ != exclusive)
+            {
+                if (exclusive)
+                {
+                    if (!global_.try_unlock_upgrade_and_lock())
+                        return false;
+                }
+                else
+                    global_.unlock_and_lock_upgrade();
+                n.passed_exclusive_ = exclusive;
+            }
+            n.passed_ = false;
+            n.owned_ = true;
+            token_node_ = i;
+            return true;
+        }
+        if (n.owned_)
+            return false;
+    }
+    {
+        std::lock_guard<mutex_t> _(cmut_);
+        if (holder_ >= 0)
+            return false;
+        if (!(exclusive ? global_.try_lock() : global_.try_lock_upgrade()))
+            return false;
+        holder_ = static_cast<int>(i);
+    }
+    std::lock_guard<mutex_t> _(n.mut_);
+    n.owned_ = true;
+    n.batch_ = 0;
+    token_node_ = i;
+    return true;
+}
+
+// Converts the caller's shared ownership into the token, with the inner
+// mutex in upgrade mode.  Waits until *abs_time, or not at all if
+// abs_time is null.
+
+bool
+cohort_upgrade_mutex::__acquire_from_shared(const time_point* abs_time)
+{
+    unsigned i = __node_index();
+    __cohort_node& n = nodes_[i];
+    std::unique_lock<mutex_t> lk(n.mut_);
+    if (abs_time != nullptr)
+        ++n.waiting_;
+    while (true)
+    {
+        if (n.passed_)
+        {
+            // The inner mutex can't be exclusive while the caller reads
+            assert(!n.passed_exclusive_);
+            n.passed_ = false;
+            n.owned_ = true;
+            if (abs_time != nullptr)
+                --n.waiting_;
+            token_node_ = i;
+            global_.unlock_shared();
+            return true;
+        }
+        if (!n.owned_ && !n.requested_)
+        {
+            bool got = false;
+            if (abs_time != nullptr)
+                n.requested_ = true;
+            lk.unlock();
+            {
+                std::lock_guard<mutex_t> _(cmut_);
+                if (holder_ < 0)
+                {
+                    got = global_.try_unlock_shared_and_lock_upgrade();
+                    if (got)
+                        holder_ = static_cast<int>(i);
+                }
+                else if (abs_time != nullptr)
+                    n.wants_ = true;
+            }
+            lk.lock();
+            if (got)
+            {
+                n.requested_ = false;
+                n.owned_ = true;
+                n.batch_ = 0;
+                if (abs_time != nullptr)
+                    --n.waiting_;
+                token_node_ = i;
+                return true;
+            }
+            if (abs_time == nullptr)
+                return false;
+            continue;
+        }
+        if (abs_time == nullptr)
+            return false;
+        if (n.gate_.wait_until(lk, *abs_time) == std::cv_status::timeout &&
+            !n.passed_)
+        {
+            --n.waiting_;
+            return false;
+        }
+    }
+}
+
+// Gives up the token.  If keep_shared the caller keeps shared ownership.
+
+void
+cohort_upgrade_mutex::__release(bool exclusive, bool keep_shared)
+{
+    unsigned i = token_node_;
+    __cohort_node& n = nodes_[i];
+    bool requeue;
+    {
+        std::lock_guard<mutex_t> _(n.mut_);
+        n.owned_ = false;
+        if (n.waiting_ != 0 && n.batch_ < max_batch_)
+        {
+            ++n.batch_;
+            if (keep_shared)
+            {
+                if (exclusive)
+                    global_.unlock_and_lock_upgrade();
+                global_.lock_shared();
+                exclusive = false;
+            }
+            n.passed_ = true;
+            n.passed_exclusive_ = exclusive;
+            n.gate_.notify_all();
+            return;
+        }
+        // The batch is used up: waiters here queue behind the other nodes
+        requeue = n.waiting_ != 0;
+        if (requeue)
+            n.requested_ = true;
+    }
+    __hand_off(i, exclusive, keep_shared, requeue);
+}
+
+// Passes the token to the next node after from that asked for it, from
+// itself last, or releases the inner mutex if none did.
+
+void
+cohort_upgrade_mutex::__hand_off(unsigned from, bool exclusive,
+                                 bool keep_shared, bool requeue)
+{
+    std::lock_guard<mutex_t> _(cmut_);
+    if (requeue)
+        nodes_[from].wants_ = true;
+    while (true)
+    {
+        unsigned j = from;
+        bool found = false;
+        for (unsigned k = 1; k <= n_nodes_ && !found; ++k)
+        {
+            j = (from + k) % n_nodes_;
+            found = nodes_[j].wants_;
+        }
+        if (!found)
+        {
+            holder_ = -1;
+            if (keep_shared)
+            {
+                if (exclusive)
+                    global_.unlock_and_lock_shared();
+                else
+                    global_.unlock_upgrade_and_lock_shared();
+            }
+            else if (exclusive)
+                global_.unlock();
+            else
+                global_.unlock_upgrade();
+            return;
+        }
+        __cohort_node& n = nodes_[j];
+        n.wants_ = false;
+        std::lock_guard<mutex_t> __(n.mut_);
+        n.requested_ = false;
+        if (n.waiting_ != 0)
+        {
+            if (keep_shared)
+            {
+                if (exclusive)
+                    global_.unlock_and_lock_upgrade();
+                global_.lock_shared();
+                exclusive = false;
+            }
+            holder_ = static_cast<int>(j);
+            n.batch_ = 0;
+            n.passed_ = true;
+            n.passed_exclusive_ = exclusive;
+            n.gate_.notify_all();
+            return;
+        }
+        // everyone waiting there timed out
+    }
+}
+
+// Exclusive ownership
+
+void
+cohort_upgrade_mutex::lock()
+{
+    bool exclusive;
+    __acquire(nullptr, exclusive);
+    if (!exclusive)
+        global_.unlock_upgrade_and_lock();
+}
+
+bool
+cohort_upgrade_mutex::try_lock()
+{
+    return __try_acquire(true);
+}
+
+bool
+cohort_upgrade_mutex::__try_lock_until(time_point abs_time)
+{
+    bool exclusive;
+    if (!__acquire(&abs_time, exclusive))
+        return false;
+    if (exclusive || global_.try_unlock_upgrade_and_lock_until(abs_time))
+        return true;
+    __release(false, false);
+    return false;
+}
+
+void
+cohort_upgrade_mutex::unlock()
+{
+    __release(true, false);
+}
+
+// Upgrade ownership
+
+void
+cohort_upgrade_mutex::lock_upgrade()
+{
+    bool exclusive;
+    __acquire(nullptr, exclusive);
+    if (exclusive)
+        global_.unlock_and_lock_upgrade();
+}
+
+bool
+cohort_upgrade_mutex::try_lock_upgrade()
+{
+    return __try_acquire(false);
+}
+
+bool
+cohort_upgrade_mutex::__try_lock_upgrade_until(time_point abs_time)
+{
+    bool exclusive;
+    if (!__acquire(&abs_time, exclusive))
+        return false;
+    if (exclusive)
+        global_.unlock_and_lock_upgrade();
+    return true;
+}
+
+void
+cohort_upgrade_mutex::unlock_upgrade()
+{
+    __release(false, false);
+}
+
+// Shared <-> Exclusive
+
+bool
+cohort_upgrade_mutex::try_unlock_shared_and_lock()
+{
+    if (!__acquire_from_shared(nullptr))
+        return false;
+    if (global_.try_unlock_upgrade_and_lock())
+        return true;
+    __release(false, true);
+    return false;
+}
+
+bool
+cohort_upgrade_mutex::__try_unlock_shared_and_lock_until(time_point abs_time)
+{
+    if (!__acquire_from_shared(&abs_time))
+        return false;
+    if (global_.try_unlock_upgrade_and_lock_until(abs_time))
+        return true;
+    __release(false, true);
+    return false;
+}
+
+void
+cohort_upgrade_mutex::unlock_and_lock_shared()
+{
+    __release(true, true);
+}
+
+// Shared <-> Upgrade
+
+bool
+cohort_upgrade_mutex::try_unlock_shared_and_lock_upgrade()
+{
+    return __acquire_from_shared(nullptr);
+}
+
+bool
+cohort_upgrade_mutex::__try_unlock_shared_and_lock_upgrade_until(
+                                                            time_point abs_time)
+{
+    return __acquire_from_shared(&abs_time);
+}
+
+void
+cohort_upgrade_mutex::unlock_upgrade_and_lock_shared()
+{
+    __release(false, true);
 }
 
 }  // ting
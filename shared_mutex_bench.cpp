@@ -0,0 +1,1263 @@
+// Copyright Howard Hinnant. Distributed under the Boost
+// Software License, Version 1.0. (see http://www.boost.org/LICENSE_1_0.txt)
+
+// Throughput, latency and torture harness for the ting reader-writer
+// mutexes.
+//
+// Each configuration runs a fixed number of threads against one mutex
+// for a fixed wall time.  Every thread picks read or write at random
+// with the configured read ratio, times how long acquisition takes, and
+// then spins in the critical section.  Inside the critical section the
+// thread verifies reader/writer exclusion against shared counters and
+// aborts on the first violation, so the program doubles as a stress test.
+// Build with -fsanitize=thread to also have the data races checked.
+//
+// The sweep covers thread count (up to twice the hardware concurrency,
+// to oversubscribe), read ratio and critical section length for
+// ting::shared_mutex, ting::upgrade_mutex, every basic_shared_mutex
+// policy and a baseline.  The baseline is std::shared_mutex when built
+// with -DBENCH_STD_SHARED_MUTEX, and pthread_rwlock_t otherwise (it is
+// the primitive std::shared_mutex wraps in libstdc++).  A second phase
+// checks every short sequence of upgrade_mutex ownership transitions
+// against a model, checks that every call which blocks is woken when
+// what blocks it is released, then drives every conversion and
+// transfer_lock concurrently, for upgrade_mutex and cohort_upgrade_mutex.
+// A third phase pins threads round robin across the NUMA nodes and
+// compares how often exclusive and upgrade ownership migrates between
+// nodes under upgrade_mutex and cohort_upgrade_mutex.  On a machine with
+// fewer nodes than the second argument asks for, the CPUs are split into
+// that many simulated nodes.  A fourth phase compares shared_mutex,
+// upgrade_mutex and rcu_snapshot on lookups in a small table at 99.9%
+// reads, with every write publishing a whole new table.  A last phase
+// measures how far past their deadline the timed try_lock functions
+// return when the mutex is never released.
+//
+//   c++ -std=c++14 -O2 -I. shared_mutex_bench.cpp shared_mutex.cpp -pthread
+//   ./a.out [milliseconds per configuration] [simulated nodes]
+
+#include "shared_mutex"
+#include "rcu_snapshot"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#if BENCH_STD_SHARED_MUTEX
+#include <shared_mutex>
+#endif
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+#if BENCH_STD_SHARED_MUTEX
+
+typedef std::shared_mutex baseline_mutex;
+const char baseline_name[] = "std::shared_mutex";
+
+#else
+
+class baseline_mutex
+{
+    pthread_rwlock_t rw_;
+public:
+    baseline_mutex() {pthread_rwlock_init(&rw_, nullptr);}
+    ~baseline_mutex() {pthread_rwlock_destroy(&rw_);}
+
+    baseline_mutex(const baseline_mutex&) = delete;
+    baseline_mutex& operator=(const baseline_mutex&) = delete;
+
+    void lock() {pthread_rwlock_wrlock(&rw_);}
+    void unlock() {pthread_rwlock_unlock(&rw_);}
+    void lock_shared() {pthread_rwlock_rdlock(&rw_);}
+    void unlock_shared() {pthread_rwlock_unlock(&rw_);}
+};
+const char baseline_name[] = "pthread_rwlock_t";
+
+#endif
+
+struct config
+{
+    unsigned threads;
+    unsigned read_percent;
+    unsigned cs_work;      // spin iterations inside the critical section
+};
+
+struct result
+{
+    double ops_per_sec;
+    double p50;            // acquisition latency percentiles, ns
+    double p99;
+    double p999;
+};
+
+// Tracks who is inside the critical section
+
+struct ownership
+{
+    std::atomic<unsigned> readers;
+    std::atomic<unsigned> upgraders;
+    std::atomic<unsigned> writers;
+
+    ownership() : readers(0), upgraders(0), writers(0) {}
+};
+
+void
+check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "exclusion violated: %s\n", what);
+        std::abort();
+    }
+}
+
+void
+enter_exclusive(ownership& o)
+{
+    check(o.writers.fetch_add(1) == 0, "two writers");
+    check(o.readers.load() == 0, "writer with readers");
+    check(o.upgraders.load() == 0, "writer with upgrader");
+}
+
+void leave_exclusive(ownership& o) {o.writers.fetch_sub(1);}
+
+void
+enter_shared(ownership& o)
+{
+    o.readers.fetch_add(1);
+    check(o.writers.load() == 0, "reader with writer");
+}
+
+void leave_shared(ownership& o) {o.readers.fetch_sub(1);}
+
+void
+enter_upgrade(ownership& o)
+{
+    check(o.upgraders.fetch_add(1) == 0, "two upgraders");
+    check(o.writers.load() == 0, "upgrader with writer");
+}
+
+void leave_upgrade(ownership& o) {o.upgraders.fetch_sub(1);}
+
+void
+spin(unsigned n)
+{
+    for (volatile unsigned i = 0; i < n; i = i + 1)
+        ;
+}
+
+class xorshift
+{
+    std::uint32_t s_;
+public:
+    explicit xorshift(std::uint32_t s) : s_(s | 1) {}
+    std::uint32_t operator()()
+    {
+        s_ ^= s_ << 13;
+        s_ ^= s_ >> 17;
+        s_ ^= s_ << 5;
+        return s_;
+    }
+};
+
+const std::size_t max_samples = 1 << 18;  // per thread
+
+void
+record(std::vector<std::uint32_t>& s, Clock::duration d)
+{
+    if (s.size() < max_samples)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        s.push_back(ns > UINT32_MAX ? UINT32_MAX : static_cast<std::uint32_t>(ns));
+    }
+}
+
+double
+percentile(std::vector<std::uint32_t>& v, double p)
+{
+    if (v.empty())
+        return 0;
+    std::size_t k = static_cast<std::size_t>(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+template <class Mutex>
+result
+run(const config& c, std::chrono::milliseconds length)
+{
+    Mutex m;
+    ownership o;
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    std::vector<std::vector<std::uint32_t> > samples(c.threads);
+    std::vector<unsigned long long> ops(c.threads);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < c.threads; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            xorshift rnd(2654435761u * (t + 1));
+            std::vector<std::uint32_t>& s = samples[t];
+            s.reserve(max_samples);
+            unsigned long long n = 0;
+            while (!go.load())
+                std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                Clock::time_point t0 = Clock::now();
+                if (rnd() % 100 < c.read_percent)
+                {
+                    m.lock_shared();
+                    record(s, Clock::now() - t0);
+                    enter_shared(o);
+                    spin(c.cs_work);
+                    leave_shared(o);
+                    m.unlock_shared();
+                }
+                else
+                {
+                    m.lock();
+                    record(s, Clock::now() - t0);
+                    enter_exclusive(o);
+                    spin(c.cs_work);
+                    leave_exclusive(o);
+                    m.unlock();
+                }
+                ++n;
+            }
+            ops[t] = n;
+        });
+    }
+    Clock::time_point start = Clock::now();
+    go = true;
+    std::this_thread::sleep_for(length);
+    stop = true;
+    for (auto& t : threads)
+        t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    std::vector<std::uint32_t> all;
+    unsigned long long total = 0;
+    for (unsigned t = 0; t < c.threads; ++t)
+    {
+        all.insert(all.end(), samples[t].begin(), samples[t].end());
+        total += ops[t];
+    }
+    result r;
+    r.ops_per_sec = total / secs;
+    r.p50 = percentile(all, 0.50);
+    r.p99 = percentile(all, 0.99);
+    r.p999 = percentile(all, 0.999);
+    return r;
+}
+
+template <class Mutex>
+void
+sweep(const char* name, const std::vector<unsigned>& thread_counts,
+      std::chrono::milliseconds length)
+{
+    const unsigned read_percents[] = {50, 90, 99};
+    const unsigned cs_works[] = {0, 100, 1000};
+    for (unsigned threads : thread_counts)
+    {
+        for (unsigned read_percent : read_percents)
+        {
+            for (unsigned cs_work : cs_works)
+            {
+                config c = {threads, read_percent, cs_work};
+                result r = run<Mutex>(c, length);
+                std::printf("%-32s %4u %5u%% %5u %10.3f %9.0f %9.0f %9.0f\n",
+                            name, threads, read_percent, cs_work,
+                            r.ops_per_sec / 1e6, r.p50, r.p99, r.p999);
+                std::fflush(stdout);
+            }
+        }
+    }
+}
+
+// Drives every upgrade_mutex conversion concurrently.  Each operation
+// checks exclusion in every ownership mode it passes through.
+
+template <class Mutex>
+void
+conversion_op(Mutex& m, ownership& o, unsigned which)
+{
+    typedef ting::shared_lock<Mutex>  ushared;
+    typedef ting::upgrade_lock<Mutex> uupgrade;
+    typedef std::unique_lock<Mutex>   uunique;
+    const std::chrono::microseconds timeout(50);
+    switch (which)
+    {
+    case 0:  // upgrade -> exclusive -> shared
+        {
+            uupgrade ul(m);
+            enter_upgrade(o);
+            leave_upgrade(o);
+            uunique xl(std::move(ul));
+            enter_exclusive(o);
+            leave_exclusive(o);
+            ushared sl(std::move(xl));
+            enter_shared(o);
+            leave_shared(o);
+        }
+        break;
+    case 1:  // shared -> upgrade (try) -> shared
+        {
+            ushared sl(m);
+            uupgrade ul(std::move(sl), std::try_to_lock);
+            if (ul.owns_lock())
+            {
+                enter_upgrade(o);
+                leave_upgrade(o);
+                ushared sl2(std::move(ul));
+                enter_shared(o);
+                leave_shared(o);
+            }
+        }
+        break;
+    case 2:  // shared -> exclusive (try, timed)
+        {
+            ushared sl(m);
+            uunique xl(std::move(sl), std::try_to_lock);
+            if (!xl.owns_lock())
+            {
+                ushared sl2(m);
+                uunique xl2(std::move(sl2), timeout);
+                if (xl2.owns_lock())
+                {
+                    enter_exclusive(o);
+                    leave_exclusive(o);
+                }
+            }
+            else
+            {
+                enter_exclusive(o);
+                leave_exclusive(o);
+            }
+        }
+        break;
+    case 3:  // upgrade -> exclusive (try, timed)
+        {
+            uupgrade ul(m);
+            uunique xl(std::move(ul), std::try_to_lock);
+            if (!xl.owns_lock())
+            {
+                uupgrade ul2(m, timeout);
+                if (ul2.owns_lock())
+                {
+                    uunique xl2(std::move(ul2), timeout);
+                    if (xl2.owns_lock())
+                    {
+                        enter_exclusive(o);
+                        leave_exclusive(o);
+                    }
+                }
+            }
+            else
+            {
+                enter_exclusive(o);
+                leave_exclusive(o);
+            }
+        }
+        break;
+    case 4:  // exclusive -> upgrade -> shared
+        {
+            uunique xl(m);
+            enter_exclusive(o);
+            leave_exclusive(o);
+            uupgrade ul(std::move(xl));
+            enter_upgrade(o);
+            leave_upgrade(o);
+            ushared sl(std::move(ul));
+            enter_shared(o);
+            leave_shared(o);
+        }
+        break;
+    case 5:  // transfer_lock within upgrade ownership
+        {
+            uupgrade ul(m);
+            enter_upgrade(o);
+            leave_upgrade(o);
+            {
+                ting::transfer_lock<uunique, uupgrade> t(ul);
+                enter_exclusive(o);
+                leave_exclusive(o);
+            }
+            check(ul.owns_lock(), "transfer_lock did not restore ownership");
+            enter_upgrade(o);
+            leave_upgrade(o);
+        }
+        break;
+    case 6:  // timed acquisition in every mode
+        {
+            uunique xl(m, timeout);
+            if (xl.owns_lock())
+            {
+                enter_exclusive(o);
+                leave_exclusive(o);
+            }
+        }
+        {
+            ushared sl(m, timeout);
+            if (sl.owns_lock())
+            {
+                enter_shared(o);
+                leave_shared(o);
+            }
+        }
+        break;
+    default:  // plain readers keep conversions contended
+        {
+            ushared sl(m);
+            enter_shared(o);
+            spin(50);
+            leave_shared(o);
+        }
+        break;
+    }
+}
+
+template <class Mutex>
+void
+conversion_storm(const char* name, Mutex& m, unsigned threads,
+                 std::chrono::milliseconds length)
+{
+    ownership o;
+    std::atomic<bool> stop(false);
+    std::vector<unsigned long long> ops(threads);
+    std::vector<std::thread> th;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        th.emplace_back([&, t]
+        {
+            xorshift rnd(40503u * (t + 1));
+            unsigned long long n = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                conversion_op(m, o, rnd() % 10);
+                ++n;
+            }
+            ops[t] = n;
+        });
+    }
+    std::this_thread::sleep_for(length);
+    stop = true;
+    for (auto& t : th)
+        t.join();
+    unsigned long long total = 0;
+    for (unsigned long long n : ops)
+        total += n;
+    std::printf("%-20s conversion storm %4u threads %10.3f Mops/s\n", name,
+                threads, total / std::chrono::duration<double>(length).count() / 1e6);
+}
+
+// Checks the upgrade_mutex ownership state machine exhaustively.  Every
+// sequence of up to model_depth transitions from the unlocked state is
+// replayed on a fresh mutex by one thread and compared with a model of
+// what the ownership rules allow.  The mutex is then probed to check
+// that its state matches the model.  Each transition is one atomic
+// step, so the sequences cover every state and edge of the machine.
+// They include the waiting bits left behind by timed calls that timed
+// out.  The races between the steps are left to conversion_storm.
+
+struct model
+{
+    unsigned readers;      // shared owners, not counting the upgrader
+    bool upgrade;
+    bool exclusive;
+};
+
+const unsigned model_ops = 24;
+const unsigned model_depth = 4;
+const unsigned model_max_readers = 3;
+
+// Applies transition op to m and s, checking that m agrees with s.
+// Returns false, leaving both alone, if op would block or break the
+// preconditions in state s.
+
+template <class Mutex>
+bool
+model_apply(Mutex& m, model& s, unsigned op)
+{
+    const std::chrono::nanoseconds now(0);
+    bool free = s.readers == 0 && !s.upgrade && !s.exclusive;
+    bool ok;
+    switch (op)
+    {
+    case 0:
+        if (!free)
+            return false;
+        m.lock();
+        s.exclusive = true;
+        return true;
+    case 1:
+    case 2:
+        ok = op == 1 ? m.try_lock() : m.try_lock_for(now);
+        check(ok == free, "model: try_lock");
+        s.exclusive |= ok;
+        return true;
+    case 3:
+        if (!s.exclusive)
+            return false;
+        m.unlock();
+        s.exclusive = false;
+        return true;
+    case 4:
+        if (s.exclusive || s.readers == model_max_readers)
+            return false;
+        m.lock_shared();
+        ++s.readers;
+        return true;
+    case 5:
+    case 6:
+        if (s.readers == model_max_readers)
+            return false;
+        ok = op == 5 ? m.try_lock_shared() : m.try_lock_shared_for(now);
+        check(ok == !s.exclusive, "model: try_lock_shared");
+        s.readers += ok;
+        return true;
+    case 7:
+        if (s.readers == 0)
+            return false;
+        m.unlock_shared();
+        --s.readers;
+        return true;
+    case 8:
+        if (s.exclusive || s.upgrade)
+            return false;
+        m.lock_upgrade();
+        s.upgrade = true;
+        return true;
+    case 9:
+    case 10:
+        ok = op == 9 ? m.try_lock_upgrade() : m.try_lock_upgrade_for(now);
+        check(ok == (!s.exclusive && !s.upgrade), "model: try_lock_upgrade");
+        s.upgrade |= ok;
+        return true;
+    case 11:
+        if (!s.upgrade)
+            return false;
+        m.unlock_upgrade();
+        s.upgrade = false;
+        return true;
+    case 12:
+    case 13:
+        if (s.readers == 0)
+            return false;
+        ok = op == 12 ? m.try_unlock_shared_and_lock() :
+                        m.try_unlock_shared_and_lock_for(now);
+        check(ok == (s.readers == 1 && !s.upgrade), "model: try_unlock_shared_and_lock");
+        if (ok)
+        {
+            s.readers = 0;
+            s.exclusive = true;
+        }
+        return true;
+    case 14:
+        if (!s.exclusive)
+            return false;
+        m.unlock_and_lock_shared();
+        s.exclusive = false;
+        s.readers = 1;
+        return true;
+    case 15:
+    case 16:
+        if (s.readers == 0)
+            return false;
+        ok = op == 15 ? m.try_unlock_shared_and_lock_upgrade() :
+                        m.try_unlock_shared_and_lock_upgrade_for(now);
+        check(ok == !s.upgrade, "model: try_unlock_shared_and_lock_upgrade");
+        if (ok)
+        {
+            --s.readers;
+            s.upgrade = true;
+        }
+        return true;
+    case 17:
+        if (!s.upgrade || s.readers == model_max_readers)
+            return false;
+        m.unlock_upgrade_and_lock_shared();
+        s.upgrade = false;
+        ++s.readers;
+        return true;
+    case 18:
+        if (!s.upgrade || s.readers != 0)
+            return false;
+        m.unlock_upgrade_and_lock();
+        s.upgrade = false;
+        s.exclusive = true;
+        return true;
+    case 19:
+    case 20:
+        if (!s.upgrade)
+            return false;
+        ok = op == 19 ? m.try_unlock_upgrade_and_lock() :
+                        m.try_unlock_upgrade_and_lock_for(now);
+        check(ok == (s.readers == 0), "model: try_unlock_upgrade_and_lock");
+        if (ok)
+        {
+            s.upgrade = false;
+            s.exclusive = true;
+        }
+        return true;
+    case 21:
+        if (!s.exclusive)
+            return false;
+        m.unlock_and_lock_upgrade();
+        s.exclusive = false;
+        s.upgrade = true;
+        return true;
+    case 22:
+        // Probe for exclusive ownership, undone at once
+        ok = m.try_lock();
+        check(ok == free, "model: probe try_lock");
+        if (ok)
+            m.unlock();
+        return true;
+    case 23:
+        ok = m.try_lock_upgrade_for(now);
+        check(ok == (!s.exclusive && !s.upgrade), "model: probe try_lock_upgrade");
+        if (ok)
+            m.unlock_upgrade();
+        return true;
+    }
+    return false;
+}
+
+// Gives up the ownership s says m has and checks m is then unlocked
+
+template <class Mutex>
+void
+model_release(Mutex& m, const model& s)
+{
+    check(m.try_lock_shared() == !s.exclusive, "model: final try_lock_shared");
+    if (!s.exclusive)
+        m.unlock_shared();
+    if (s.exclusive)
+        m.unlock();
+    if (s.upgrade)
+        m.unlock_upgrade();
+    for (unsigned r = 0; r < s.readers; ++r)
+        m.unlock_shared();
+    check(m.try_lock(), "model: not unlocked");
+    m.unlock();
+}
+
+template <class Mutex>
+unsigned long long
+model_walk(std::vector<unsigned>& path)
+{
+    unsigned long long checked = 0;
+    for (unsigned op = 0; op < model_ops; ++op)
+    {
+        Mutex m;
+        model s = {0, false, false};
+        for (unsigned p : path)
+            model_apply(m, s, p);
+        bool applied = model_apply(m, s, op);
+        model_release(m, s);
+        if (!applied)
+            continue;
+        ++checked;
+        if (path.size() + 1 < model_depth)
+        {
+            path.push_back(op);
+            checked += model_walk<Mutex>(path);
+            path.pop_back();
+        }
+    }
+    return checked;
+}
+
+template <class Mutex>
+void
+model_check(const char* name)
+{
+    std::vector<unsigned> path;
+    unsigned long long checked = model_walk<Mutex>(path);
+    std::printf("%-20s state machine    %llu sequences ok\n", name, checked);
+    std::fflush(stdout);
+}
+
+// Wakeups
+//
+// model_check runs on one thread and never blocks.  Here each call that
+// can block is parked on a second thread behind ownership the main thread
+// holds.  The main thread then gives that ownership up, in two steps where
+// one is not enough to let the call proceed.  The call must stay blocked
+// after the first step and return, successfully, promptly after the last:
+// a lost wakeup leaves a blocking call hung and a timed call running to
+// its deadline.
+
+template <class Mutex>
+struct parked_call
+{
+    const char* what;
+    void (*hold)(Mutex&);    // the blocker, taken first by the main thread
+    void (*setup)(Mutex&);   // what call converts from, or nullptr
+    bool (*call)(Mutex&);
+    void (*finish)(Mutex&);  // gives up what call obtained
+    void (*step)(Mutex&);    // the blocker gives up part, or nullptr
+    void (*leave)(Mutex&);   // the blocker gives up the rest
+};
+
+const std::chrono::milliseconds park_settle(20);
+const std::chrono::milliseconds wakeup_limit(200);
+const std::chrono::seconds park_deadline(10);  // for the timed calls
+
+template <class Mutex>
+void
+park(const parked_call<Mutex>& c)
+{
+    Mutex m;
+    c.hold(m);
+    std::atomic<unsigned> stage(0);  // 1 when set up, 2 when call returns
+    bool ok = false;
+    std::thread t([&]
+        {
+            if (c.setup)
+                c.setup(m);
+            stage = 1;
+            ok = c.call(m);
+            stage = 2;
+            if (ok)
+                c.finish(m);
+        });
+    while (stage == 0)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(park_settle);
+    check(stage == 1, c.what);
+    if (c.step)
+    {
+        c.step(m);
+        std::this_thread::sleep_for(park_settle);
+        check(stage == 1, c.what);
+    }
+    Clock::time_point t0 = Clock::now();
+    c.leave(m);
+    while (stage != 2 && Clock::now() - t0 < wakeup_limit)
+        std::this_thread::yield();
+    check(stage == 2, c.what);  // still parked: the wakeup was lost
+    t.join();
+    check(ok, c.what);
+}
+
+template <class Mutex>
+void
+wakeup_check(const char* name)
+{
+    typedef parked_call<Mutex> P;
+    const P calls[] =
+    {
+        {"wakeup: lock behind lock",
+         [](Mutex& m) {m.lock();}, nullptr,
+         [](Mutex& m) {m.lock(); return true;},
+         [](Mutex& m) {m.unlock();},
+         nullptr, [](Mutex& m) {m.unlock();}},
+        {"wakeup: lock behind upgrade",
+         [](Mutex& m) {m.lock_upgrade(); m.lock_shared();}, nullptr,
+         [](Mutex& m) {m.lock(); return true;},
+         [](Mutex& m) {m.unlock();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_upgrade();}},
+        {"wakeup: lock behind readers",
+         [](Mutex& m) {m.lock_shared(); m.lock_shared();}, nullptr,
+         [](Mutex& m) {m.lock(); return true;},
+         [](Mutex& m) {m.unlock();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_shared();}},
+        {"wakeup: try_lock_for behind lock",
+         [](Mutex& m) {m.lock();}, nullptr,
+         [](Mutex& m) {return m.try_lock_for(park_deadline);},
+         [](Mutex& m) {m.unlock();},
+         nullptr, [](Mutex& m) {m.unlock();}},
+        {"wakeup: try_lock_for behind readers",
+         [](Mutex& m) {m.lock_shared(); m.lock_shared();}, nullptr,
+         [](Mutex& m) {return m.try_lock_for(park_deadline);},
+         [](Mutex& m) {m.unlock();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_shared();}},
+        {"wakeup: lock_shared behind lock",
+         [](Mutex& m) {m.lock();}, nullptr,
+         [](Mutex& m) {m.lock_shared(); return true;},
+         [](Mutex& m) {m.unlock_shared();},
+         nullptr, [](Mutex& m) {m.unlock();}},
+        {"wakeup: try_lock_shared_for behind lock",
+         [](Mutex& m) {m.lock();}, nullptr,
+         [](Mutex& m) {return m.try_lock_shared_for(park_deadline);},
+         [](Mutex& m) {m.unlock_shared();},
+         nullptr, [](Mutex& m) {m.unlock();}},
+        {"wakeup: lock_upgrade behind upgrade",
+         [](Mutex& m) {m.lock_upgrade(); m.lock_shared();}, nullptr,
+         [](Mutex& m) {m.lock_upgrade(); return true;},
+         [](Mutex& m) {m.unlock_upgrade();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_upgrade();}},
+        {"wakeup: lock_upgrade behind lock",
+         [](Mutex& m) {m.lock();}, nullptr,
+         [](Mutex& m) {m.lock_upgrade(); return true;},
+         [](Mutex& m) {m.unlock_upgrade();},
+         nullptr, [](Mutex& m) {m.unlock();}},
+        {"wakeup: try_lock_upgrade_for behind upgrade",
+         [](Mutex& m) {m.lock_upgrade(); m.lock_shared();}, nullptr,
+         [](Mutex& m) {return m.try_lock_upgrade_for(park_deadline);},
+         [](Mutex& m) {m.unlock_upgrade();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_upgrade();}},
+        {"wakeup: try_unlock_shared_and_lock_for behind readers",
+         [](Mutex& m) {m.lock_shared(); m.lock_shared();},
+         [](Mutex& m) {m.lock_shared();},
+         [](Mutex& m) {return m.try_unlock_shared_and_lock_for(park_deadline);},
+         [](Mutex& m) {m.unlock();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_shared();}},
+        {"wakeup: try_unlock_shared_and_lock_upgrade_for behind upgrade",
+         [](Mutex& m) {m.lock_upgrade(); m.lock_shared();},
+         [](Mutex& m) {m.lock_shared();},
+         [](Mutex& m) {return m.try_unlock_shared_and_lock_upgrade_for(
+                                                               park_deadline);},
+         [](Mutex& m) {m.unlock_upgrade();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_upgrade();}},
+        {"wakeup: unlock_upgrade_and_lock behind readers",
+         [](Mutex& m) {m.lock_shared(); m.lock_shared();},
+         [](Mutex& m) {m.lock_upgrade();},
+         [](Mutex& m) {m.unlock_upgrade_and_lock(); return true;},
+         [](Mutex& m) {m.unlock();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_shared();}},
+        {"wakeup: try_unlock_upgrade_and_lock_for behind readers",
+         [](Mutex& m) {m.lock_shared(); m.lock_shared();},
+         [](Mutex& m) {m.lock_upgrade();},
+         [](Mutex& m) {return m.try_unlock_upgrade_and_lock_for(
+                                                               park_deadline);},
+         [](Mutex& m) {m.unlock();},
+         [](Mutex& m) {m.unlock_shared();}, [](Mutex& m) {m.unlock_shared();}},
+    };
+    for (const P& c : calls)
+        park(c);
+    std::printf("%-20s wakeups          %u calls ok\n", name,
+                static_cast<unsigned>(sizeof(calls) / sizeof(calls[0])));
+    std::fflush(stdout);
+}
+
+// NUMA handoff
+
+// CPUs of each NUMA node.  With fewer real nodes than wanted, the CPUs are
+// dealt out into that many simulated nodes instead.
+
+std::vector<unsigned>
+parse_cpulist(const char* s)
+{
+    // a list such as "0-3,8-11"
+    std::vector<unsigned> cpus;
+    while (*s >= '0' && *s <= '9')
+    {
+        char* e;
+        unsigned first = static_cast<unsigned>(std::strtoul(s, &e, 10));
+        unsigned last = first;
+        if (*e == '-')
+            last = static_cast<unsigned>(std::strtoul(e + 1, &e, 10));
+        for (unsigned c = first; c <= last; ++c)
+            cpus.push_back(c);
+        s = *e == ',' ? e + 1 : e;
+    }
+    return cpus;
+}
+
+std::vector<std::vector<unsigned> >
+node_cpus(unsigned wanted)
+{
+    std::vector<std::vector<unsigned> > nodes;
+    for (unsigned n = 0;; ++n)
+    {
+        char path[64];
+        std::snprintf(path, sizeof(path),
+                      "/sys/devices/system/node/node%u/cpulist", n);
+        std::FILE* f = std::fopen(path, "r");
+        if (f == nullptr)
+            break;
+        char buf[1024] = {};
+        if (std::fgets(buf, sizeof(buf), f) != nullptr)
+            nodes.push_back(parse_cpulist(buf));
+        std::fclose(f);
+    }
+    if (nodes.size() >= wanted)
+        return nodes;
+    std::vector<unsigned> all;
+    for (auto& n : nodes)
+        all.insert(all.end(), n.begin(), n.end());
+    if (all.empty())
+        for (unsigned c = 0; c < std::thread::hardware_concurrency(); ++c)
+            all.push_back(c);
+    nodes.assign(wanted, std::vector<unsigned>());
+    for (std::size_t i = 0; i < all.size(); ++i)
+        nodes[i * wanted / all.size()].push_back(all[i]);
+    return nodes;
+}
+
+void
+pin(const std::vector<unsigned>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (unsigned c : cpus)
+        if (c < CPU_SETSIZE)
+            CPU_SET(c, &set);
+    if (!cpus.empty())
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpus;
+#endif
+}
+
+// Threads are pinned round robin across the nodes.  A thread writes,
+// upgrades then writes, or reads.  Reports throughput and how often
+// exclusive or upgrade ownership moved to a different node.
+
+template <class Mutex>
+void
+numa_handoff(const char* name, Mutex& m,
+             const std::vector<std::vector<unsigned> >& nodes,
+             unsigned threads, unsigned read_percent,
+             std::chrono::milliseconds length)
+{
+    ownership o;
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    std::vector<unsigned long long> ops(threads);
+    unsigned long long owned = 0;      // guarded by upgrade or exclusive ownership
+    unsigned long long migrations = 0;
+    unsigned last_node = 0;
+    std::vector<std::thread> th;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        th.emplace_back([&, t]
+        {
+            unsigned node = t % nodes.size();
+            pin(nodes[node]);
+            ting::cohort_upgrade_mutex::set_this_thread_node(node);
+            xorshift rnd(2246822519u * (t + 1));
+            unsigned long long n = 0;
+            auto note_owner = [&]
+            {
+                ++owned;
+                if (node != last_node)
+                {
+                    ++migrations;
+                    last_node = node;
+                }
+            };
+            while (!go.load())
+                std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                unsigned r = rnd() % 100;
+                if (r < read_percent)
+                {
+                    m.lock_shared();
+                    enter_shared(o);
+                    spin(100);
+                    leave_shared(o);
+                    m.unlock_shared();
+                }
+                else if (r % 2 == 0)
+                {
+                    m.lock();
+                    enter_exclusive(o);
+                    note_owner();
+                    spin(100);
+                    leave_exclusive(o);
+                    m.unlock();
+                }
+                else
+                {
+                    m.lock_upgrade();
+                    enter_upgrade(o);
+                    note_owner();
+                    spin(50);
+                    leave_upgrade(o);
+                    m.unlock_upgrade_and_lock();
+                    enter_exclusive(o);
+                    spin(50);
+                    leave_exclusive(o);
+                    m.unlock();
+                }
+                ++n;
+            }
+            ops[t] = n;
+        });
+    }
+    Clock::time_point start = Clock::now();
+    go = true;
+    std::this_thread::sleep_for(length);
+    stop = true;
+    for (auto& t : th)
+        t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    unsigned long long total = 0;
+    for (unsigned long long n : ops)
+        total += n;
+    std::printf("%-28s %4u %5zu %5u%% %10.3f %10.1f%%\n", name, threads,
+                nodes.size(), read_percent, total / secs / 1e6,
+                owned == 0 ? 0. : 100. * migrations / owned);
+    std::fflush(stdout);
+}
+
+// Read-mostly lookups in a small table.  A writer bumps every entry, so
+// a reader that sees two different values saw a torn version.
+
+struct table
+{
+    std::uint64_t v[8];
+};
+
+const table&
+check_table(const table& t)
+{
+    for (std::uint64_t x : t.v)
+        check(x == t.v[0], "torn table");
+    return t;
+}
+
+template <class Mutex>
+class locked_table
+{
+    Mutex m_;
+    table t_ = {};
+public:
+    std::uint64_t read(unsigned i)
+    {
+        ting::shared_lock<Mutex> lk(m_);
+        return check_table(t_).v[i];
+    }
+
+    void write()
+    {
+        std::lock_guard<Mutex> lk(m_);
+        for (std::uint64_t& x : t_.v)
+            ++x;
+    }
+};
+
+class snapshot_table
+{
+    ting::rcu_snapshot<table> s_{std::unique_ptr<table>(new table())};
+public:
+    std::uint64_t read(unsigned i)
+    {
+        auto g = s_.read();
+        return check_table(*g).v[i];
+    }
+
+    void write()
+    {
+        s_.update([](table& t)
+        {
+            for (std::uint64_t& x : t.v)
+                ++x;
+        });
+    }
+};
+
+template <class Table>
+void
+read_mostly(const char* name, unsigned threads, std::chrono::milliseconds length)
+{
+    const unsigned reads_per_mille = 999;
+    Table tb;
+    std::atomic<bool> go(false);
+    std::atomic<bool> stop(false);
+    std::vector<unsigned long long> ops(threads);
+    std::vector<std::uint64_t> sink(threads);
+    std::vector<std::thread> th;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        th.emplace_back([&, t]
+        {
+            xorshift rnd(3266489917u * (t + 1));
+            unsigned long long n = 0;
+            std::uint64_t sum = 0;
+            while (!go.load())
+                std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                std::uint32_t r = rnd();
+                if (r % 1000 < reads_per_mille)
+                    sum += tb.read(r % 8);
+                else
+                    tb.write();
+                ++n;
+            }
+            ops[t] = n;
+            sink[t] = sum;
+        });
+    }
+    Clock::time_point start = Clock::now();
+    go = true;
+    std::this_thread::sleep_for(length);
+    stop = true;
+    for (auto& t : th)
+        t.join();
+    double secs = std::chrono::duration<double>(Clock::now() - start).count();
+    unsigned long long total = 0;
+    for (unsigned long long n : ops)
+        total += n;
+    std::printf("%-28s %4u %10.3f %10.3f\n", name, threads, total / secs / 1e6,
+                total / secs / 1e6 / threads);
+    std::fflush(stdout);
+}
+
+// Times out against a mutex held exclusively by another thread and
+// reports how late the timed try_lock functions return.  Returning
+// early is a bug and aborts.
+
+const std::chrono::microseconds timeout_request(200);
+// Linux adds 50us of timer slack to every timed wait by default.
+const std::chrono::microseconds timeout_target(100);  // p99 overshoot goal
+
+template <class Mutex>
+void
+timeout_accuracy(const char* name, unsigned samples)
+{
+    Mutex m;
+    std::atomic<bool> held(false);
+    std::atomic<bool> done(false);
+    std::thread owner([&]
+    {
+        m.lock();
+        held = true;
+        while (!done)
+            std::this_thread::yield();
+        m.unlock();
+    });
+    while (!held)
+        std::this_thread::yield();
+    std::vector<std::uint32_t> late;
+    late.reserve(samples);
+    for (unsigned i = 0; i < samples; ++i)
+    {
+        Clock::time_point t0 = Clock::now();
+        bool got;
+        switch (i % 3)
+        {
+        case 0:
+            got = m.try_lock_for(timeout_request);
+            break;
+        case 1:
+            got = m.try_lock_shared_for(timeout_request);
+            break;
+        default:
+            // exercises the conversion from a foreign clock
+            got = m.try_lock_until(std::chrono::system_clock::now() +
+                                   timeout_request);
+            break;
+        }
+        Clock::duration d = Clock::now() - t0;
+        check(!got, "timed try_lock acquired a held mutex");
+        // the foreign clock conversion may legitimately lose a little
+        check(d >= timeout_request - std::chrono::microseconds(1),
+              "timed try_lock returned before its deadline");
+        record(late, d > timeout_request ? d - timeout_request
+                                         : Clock::duration::zero());
+    }
+    done = true;
+    owner.join();
+    double p99 = percentile(late, 0.99);
+    std::printf("%-36s timeout %4lld us  late p50 %7.1f us  p99 %7.1f us  %s\n",
+                name, static_cast<long long>(timeout_request.count()),
+                percentile(late, 0.50) / 1e3, p99 / 1e3,
+                p99 <= std::chrono::nanoseconds(timeout_target).count() ?
+                    "ok" : "above target");
+}
+
+}  // unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::chrono::milliseconds length(200);
+    if (argc > 1)
+        length = std::chrono::milliseconds(std::atoi(argv[1]));
+    unsigned simulated_nodes = 1;
+    if (argc > 2)
+        simulated_nodes = static_cast<unsigned>(std::atoi(argv[2]));
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw == 0)
+        hw = 4;
+    std::vector<unsigned> thread_counts;
+    for (unsigned n = 1; n < hw; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(hw);
+    thread_counts.push_back(2 * hw);  // oversubscribed
+
+    std::printf("%-32s %4s %6s %5s %10s %9s %9s %9s\n", "mutex", "thr", "read",
+                "cs", "Mops/s", "p50 ns", "p99 ns", "p999 ns");
+    sweep<ting::shared_mutex>("ting::shared_mutex", thread_counts, length);
+    sweep<ting::upgrade_mutex>("ting::upgrade_mutex", thread_counts, length);
+    sweep<ting::basic_shared_mutex<ting::writer_priority> >(
+                  "basic_shared_mutex<writer_priority>", thread_counts, length);
+    sweep<ting::basic_shared_mutex<ting::reader_priority> >(
+                  "basic_shared_mutex<reader_priority>", thread_counts, length);
+    sweep<ting::basic_shared_mutex<ting::phase_fair> >(
+                  "basic_shared_mutex<phase_fair>", thread_counts, length);
+    sweep<ting::basic_shared_mutex<ting::task_fair> >(
+                  "basic_shared_mutex<task_fair>", thread_counts, length);
+    sweep<baseline_mutex>(baseline_name, thread_counts, length);
+
+    model_check<ting::upgrade_mutex>("upgrade_mutex");
+    model_check<ting::cohort_upgrade_mutex>("cohort_upgrade_mutex");
+    wakeup_check<ting::upgrade_mutex>("upgrade_mutex");
+    wakeup_check<ting::cohort_upgrade_mutex>("cohort_upgrade_mutex");
+    for (unsigned threads : thread_counts)
+    {
+        ting::upgrade_mutex um;
+        conversion_storm("upgrade_mutex", um, threads, length);
+        ting::cohort_upgrade_mutex cm;
+        conversion_storm("cohort_upgrade_mutex", cm, threads, length);
+    }
+
+    std::vector<std::vector<unsigned> > nodes = node_cpus(simulated_nodes);
+    std::printf("\n%-28s %4s %5s %6s %10s %11s\n", "mutex", "thr", "nodes",
+                "read", "Mops/s", "migrations");
+    for (unsigned threads : thread_counts)
+    {
+        if (threads < nodes.size())
+            continue;
+        for (unsigned read_percent : {0u, 50u, 90u})
+        {
+            ting::upgrade_mutex um;
+            numa_handoff("ting::upgrade_mutex", um, nodes, threads,
+                         read_percent, length);
+            ting::cohort_upgrade_mutex cm(64, static_cast<unsigned>(nodes.size()));
+            numa_handoff("ting::cohort_upgrade_mutex", cm, nodes, threads,
+                         read_percent, length);
+        }
+    }
+
+    std::printf("\n%-28s %4s %10s %10s\n", "99.9% reads", "thr", "Mops/s",
+                "per thread");
+    for (unsigned threads : thread_counts)
+    {
+        read_mostly<locked_table<ting::shared_mutex> >("ting::shared_mutex",
+                                                       threads, length);
+        read_mostly<locked_table<ting::upgrade_mutex> >("ting::upgrade_mutex",
+                                                        threads, length);
+        read_mostly<snapshot_table>("ting::rcu_snapshot", threads, length);
+    }
+
+    unsigned samples = static_cast<unsigned>(length.count()) * 5 + 30;
+    timeout_accuracy<ting::shared_mutex>("ting::shared_mutex", samples);
+    timeout_accuracy<ting::upgrade_mutex>("ting::upgrade_mutex", samples);
+    timeout_accuracy<ting::basic_shared_mutex<ting::writer_priority> >(
+                                 "basic_shared_mutex<writer_priority>", samples);
+    timeout_accuracy<ting::basic_shared_mutex<ting::reader_priority> >(
+                                 "basic_shared_mutex<reader_priority>", samples);
+    timeout_accuracy<ting::basic_shared_mutex<ting::phase_fair> >(
+                                 "basic_shared_mutex<phase_fair>", samples);
+    timeout_accuracy<ting::basic_shared_mutex<ting::task_fair> >(
+                                 "basic_shared_mutex<task_fair>", samples);
+}
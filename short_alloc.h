@@ -26,6 +26,29 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <new>
+
+// Under AddressSanitizer, memory given back by reset() or rollback() is
+// poisoned until it is allocated again, so a container still using it is
+// reported at the first access.
+
+#if defined(__has_feature)
+#  if __has_feature(address_sanitizer)
+#    define SHORT_ALLOC_ASAN 1
+#  endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) && !defined(SHORT_ALLOC_ASAN)
+#  define SHORT_ALLOC_ASAN 1
+#endif
+
+#ifdef SHORT_ALLOC_ASAN
+#  include <sanitizer/asan_interface.h>
+#  define SHORT_ALLOC_POISON(p, n) ASAN_POISON_MEMORY_REGION((p), (n))
+#  define SHORT_ALLOC_UNPOISON(p, n) ASAN_UNPOISON_MEMORY_REGION((p), (n))
+#else
+#  define SHORT_ALLOC_POISON(p, n) ((void)(p), (void)(n))
+#  define SHORT_ALLOC_UNPOISON(p, n) ((void)(p), (void)(n))
+#endif
 
 template <std::size_t N, std::size_t alignment = alignof(std::max_align_t)>
 class arena
@@ -34,7 +57,15 @@ class arena
     char* ptr_;
 
 public:
-    ~arena() {ptr_ = nullptr;}
+    class marker
+    {
+        char* ptr_;
+
+        explicit marker(char* p) noexcept : ptr_(p) {}
+        friend class arena;
+    };
+
+    ~arena() {SHORT_ALLOC_UNPOISON(buf_, N); ptr_ = nullptr;}
     arena() noexcept : ptr_(buf_) {}
     arena(const arena&) = delete;
     arena& operator=(const arena&) = delete;
@@ -44,7 +75,15 @@ public:
 
     static constexpr std::size_t size() noexcept {return N;}
     std::size_t used() const noexcept {return static_cast<std::size_t>(ptr_ - buf_);}
-    void reset() noexcept {ptr_ = buf_;}
+    void reset() noexcept {SHORT_ALLOC_POISON(buf_, used()); ptr_ = buf_;}
+    bool owns(const void* p) const noexcept
+    {
+        return std::uintptr_t(buf_) <= std::uintptr_t(p) &&
+               std::uintptr_t(p) < std::uintptr_t(buf_) + N;
+    }
+
+    marker mark() const noexcept {return marker(ptr_);}
+    void rollback(marker m) noexcept;
 
 private:
     static
@@ -72,6 +111,7 @@ arena<N, alignment>::allocate(std::size_t n)
     {
         char* r = ptr_;
         ptr_ += aligned_n;
+        SHORT_ALLOC_UNPOISON(r, aligned_n);
         return r;
     }
 
@@ -96,14 +136,436 @@ arena<N, alignment>::deallocate(char* p, std::size_t n) noexcept
         ::operator delete(p);
 }
 
-template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+template <std::size_t N, std::size_t alignment>
+void
+arena<N, alignment>::rollback(marker m) noexcept
+{
+    assert(pointer_in_buffer(m.ptr_) && "marker is not from this arena");
+    // If ptr_ is already below the mark, everything allocated since has
+    // been deallocated.
+    if (m.ptr_ < ptr_)
+    {
+        SHORT_ALLOC_POISON(m.ptr_, static_cast<std::size_t>(ptr_ - m.ptr_));
+        ptr_ = m.ptr_;
+    }
+}
+
+// new_delete_upstream is the default source of extra blocks for
+// growing_arena.  Any type with these two members can stand in for it.
+
+struct new_delete_upstream
+{
+    void* allocate(std::size_t n, std::size_t alignment)
+    {
+        assert(alignment <= alignof(std::max_align_t));
+        (void)alignment;
+        return ::operator new(n);
+    }
+    void deallocate(void* p, std::size_t, std::size_t) noexcept
+    {
+        ::operator delete(p);
+    }
+};
+
+// growing_arena starts out in its own N byte buffer, like arena.  When that
+// runs out it chains blocks obtained from Upstream instead of sending each
+// allocation to ::operator new.  Block sizes grow geometrically, and all
+// blocks are returned together on reset() or destruction.  As with arena,
+// only a deallocation of the most recent allocation gives memory back
+// early.
+//
+// Statistics:
+//   overflows()  allocations that did not fit in the internal buffer
+//   peak()       high-water mark of used(), in bytes
+//   blocks()     number of upstream blocks currently held
+// overflows() and peak() accumulate across reset().  So does the largest
+// total of upstream block bytes held at once, and reset() makes that the
+// size of the next block.  An arena reused per request thus gets by with
+// one block per request once it has seen its largest one, and stops
+// growing.
+
+template <std::size_t N, std::size_t alignment = alignof(std::max_align_t),
+          class Upstream = new_delete_upstream>
+class growing_arena
+{
+    struct block
+    {
+        block*      prev_;
+        std::size_t size_;
+    };
+
+    alignas(alignment) char buf_[N];
+    char*       ptr_;
+    char*       end_;
+    block*      blocks_;
+    std::size_t next_size_;
+    std::size_t block_bytes_;  // in the blocks held now
+    std::size_t block_peak_;   // high-water mark of block_bytes_
+    std::size_t used_;
+    std::size_t peak_;
+    std::size_t overflows_;
+    std::size_t nblocks_;
+    Upstream    upstream_;
+
+public:
+    class marker
+    {
+        char*       ptr_;
+        char*       end_;
+        block*      blocks_;
+        std::size_t used_;
+
+        marker(char* p, char* e, block* b, std::size_t u) noexcept
+            : ptr_(p), end_(e), blocks_(b), used_(u) {}
+        friend class growing_arena;
+    };
+
+    ~growing_arena() {release(); SHORT_ALLOC_UNPOISON(buf_, N); ptr_ = nullptr;}
+    explicit growing_arena(Upstream upstream = Upstream())
+        : ptr_(buf_), end_(buf_ + N), blocks_(nullptr),
+          next_size_(first_block_size()), block_bytes_(0), block_peak_(0),
+          used_(0), peak_(0), overflows_(0), nblocks_(0),
+          upstream_(upstream) {}
+    growing_arena(const growing_arena&) = delete;
+    growing_arena& operator=(const growing_arena&) = delete;
+
+    template <std::size_t ReqAlign> char* allocate(std::size_t n);
+    void deallocate(char* p, std::size_t n) noexcept;
+
+    static constexpr std::size_t size() noexcept {return N;}
+    std::size_t used() const noexcept {return used_;}
+    void reset() noexcept;
+
+    marker mark() const noexcept {return marker(ptr_, end_, blocks_, used_);}
+    void rollback(marker m) noexcept;
+
+    std::size_t overflows() const noexcept {return overflows_;}
+    std::size_t peak() const noexcept {return peak_;}
+    std::size_t blocks() const noexcept {return nblocks_;}
+
+private:
+    static
+    std::size_t
+    align_up(std::size_t n) noexcept
+        {return (n + (alignment-1)) & ~(alignment-1);}
+
+    static constexpr std::size_t header_size() noexcept
+        {return (sizeof(block) + (alignment-1)) & ~(alignment-1);}
+
+    static constexpr std::size_t first_block_size() noexcept
+        {return 2 * N < 1024 ? 1024 : 2 * N;}
+
+    char* grow(std::size_t aligned_n);
+    void pop_block() noexcept;
+    void release() noexcept;
+};
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+template <std::size_t ReqAlign>
+char*
+growing_arena<N, alignment, Upstream>::allocate(std::size_t n)
+{
+    static_assert(ReqAlign <= alignment, "alignment is too small for this arena");
+    assert(ptr_ != nullptr && "short_alloc has outlived arena");
+    auto const aligned_n = align_up(n);
+    char* r;
+    if (static_cast<std::size_t>(end_ - ptr_) >= aligned_n)
+    {
+        r = ptr_;
+        ptr_ += aligned_n;
+        SHORT_ALLOC_UNPOISON(r, aligned_n);
+    }
+    else
+        r = grow(aligned_n);
+    if (blocks_ != nullptr)
+        ++overflows_;
+    used_ += aligned_n;
+    if (used_ > peak_)
+        peak_ = used_;
+    return r;
+}
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+char*
+growing_arena<N, alignment, Upstream>::grow(std::size_t aligned_n)
+{
+    std::size_t size = next_size_;
+    if (size < header_size() + aligned_n)
+        size = header_size() + aligned_n;
+    block* b = static_cast<block*>(upstream_.allocate(size, alignment));
+    b->prev_ = blocks_;
+    b->size_ = size;
+    blocks_ = b;
+    ++nblocks_;
+    block_bytes_ += size;
+    if (block_bytes_ > block_peak_)
+        block_peak_ = block_bytes_;
+    next_size_ = 2 * size;
+    char* r = reinterpret_cast<char*>(b) + header_size();
+    ptr_ = r + aligned_n;
+    end_ = reinterpret_cast<char*>(b) + size;
+    return r;
+}
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+void
+growing_arena<N, alignment, Upstream>::deallocate(char* p, std::size_t n) noexcept
+{
+    assert(ptr_ != nullptr && "short_alloc has outlived arena");
+    n = align_up(n);
+    if (p + n == ptr_)
+    {
+        ptr_ = p;
+        used_ -= n;
+    }
+}
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+void
+growing_arena<N, alignment, Upstream>::reset() noexcept
+{
+    release();
+    SHORT_ALLOC_POISON(buf_, N);
+    ptr_ = buf_;
+    end_ = buf_ + N;
+    used_ = 0;
+    // One block as large as all the blocks of the largest request so far
+    next_size_ = block_peak_ > first_block_size() ? block_peak_ :
+                                                    first_block_size();
+}
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+void
+growing_arena<N, alignment, Upstream>::release() noexcept
+{
+    while (blocks_ != nullptr)
+        pop_block();
+}
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+void
+growing_arena<N, alignment, Upstream>::pop_block() noexcept
+{
+    block* b = blocks_;
+    blocks_ = b->prev_;
+    --nblocks_;
+    block_bytes_ -= b->size_;
+    SHORT_ALLOC_UNPOISON(b, b->size_);
+    upstream_.deallocate(b, b->size_, alignment);
+}
+
+// Blocks chained after the mark are returned to Upstream, newest first, so
+// the cost is one step per block rather than per allocation.
+
+template <std::size_t N, std::size_t alignment, class Upstream>
+void
+growing_arena<N, alignment, Upstream>::rollback(marker m) noexcept
+{
+    assert(ptr_ != nullptr && "short_alloc has outlived arena");
+    if (blocks_ == m.blocks_ && ptr_ <= m.ptr_)
+        return;  // everything allocated since the mark is already gone
+    while (blocks_ != m.blocks_)
+    {
+        assert(blocks_ != nullptr && "marker is not from this arena, or was "
+                                     "invalidated by an earlier rollback");
+        pop_block();
+    }
+    SHORT_ALLOC_POISON(m.ptr_, static_cast<std::size_t>(m.end_ - m.ptr_));
+    ptr_ = m.ptr_;
+    end_ = m.end_;
+    used_ = m.used_;
+}
+
+// pooled_arena is arena plus free lists for blocks freed out of order.
+// arena only takes back the most recent allocation, so node containers with
+// erase churn, or an unordered_map that rehashes, fill it with dead space
+// and then spill to the heap.  pooled_arena threads a freed block of up to
+// MaxPooled bytes onto a free list for its exact (aligned) size, stored in
+// the block itself.  The next allocation of that size takes the block from
+// the list.  A list head is checked before the bump pointer; everything
+// else behaves as in arena.
+//
+// Statistics:
+//   allocations()  calls to allocate
+//   reuses()       allocations served from a free list
+//   spills()       allocations that went to ::operator new
+
+template <std::size_t N, std::size_t alignment = alignof(std::max_align_t),
+          std::size_t MaxPooled = 16 * alignment>
+class pooled_arena
+{
+    static_assert(alignment >= sizeof(void*) && alignment % alignof(void*) == 0,
+                  "pooled_arena stores a pointer in each freed block");
+    static_assert(MaxPooled % alignment == 0,
+                  "MaxPooled needs to be a multiple of alignment");
+
+    struct node {node* next_;};
+
+    alignas(alignment) char buf_[N];
+    char*       ptr_;
+    node*       free_[MaxPooled / alignment];
+    std::size_t allocations_;
+    std::size_t reuses_;
+    std::size_t spills_;
+
+public:
+    ~pooled_arena() {ptr_ = nullptr;}
+    pooled_arena() noexcept
+        : ptr_(buf_), free_(), allocations_(0), reuses_(0), spills_(0) {}
+    pooled_arena(const pooled_arena&) = delete;
+    pooled_arena& operator=(const pooled_arena&) = delete;
+
+    template <std::size_t ReqAlign> char* allocate(std::size_t n);
+    void deallocate(char* p, std::size_t n) noexcept;
+
+    static constexpr std::size_t size() noexcept {return N;}
+    std::size_t used() const noexcept {return static_cast<std::size_t>(ptr_ - buf_);}
+    void reset() noexcept;
+    bool owns(const void* p) const noexcept
+    {
+        return std::uintptr_t(buf_) <= std::uintptr_t(p) &&
+               std::uintptr_t(p) < std::uintptr_t(buf_) + N;
+    }
+
+    std::size_t allocations() const noexcept {return allocations_;}
+    std::size_t reuses() const noexcept {return reuses_;}
+    std::size_t spills() const noexcept {return spills_;}
+
+private:
+    static
+    std::size_t
+    align_up(std::size_t n) noexcept
+        {return (n + (alignment-1)) & ~(alignment-1);}
+
+    bool
+    pointer_in_buffer(char* p) noexcept
+    {
+        return std::uintptr_t(buf_) <= std::uintptr_t(p) &&
+               std::uintptr_t(p) <= std::uintptr_t(buf_) + N;
+    }
+};
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled>
+template <std::size_t ReqAlign>
+char*
+pooled_arena<N, alignment, MaxPooled>::allocate(std::size_t n)
+{
+    static_assert(ReqAlign <= alignment, "alignment is too small for this arena");
+    assert(pointer_in_buffer(ptr_) && "short_alloc has outlived arena");
+    ++allocations_;
+    auto const aligned_n = align_up(n);
+    // aligned_n == 0 wraps and is never pooled
+    if (aligned_n - 1 < MaxPooled)
+    {
+        node*& head = free_[aligned_n / alignment - 1];
+        if (head != nullptr)
+        {
+            node* r = head;
+            head = r->next_;
+            ++reuses_;
+            return reinterpret_cast<char*>(r);
+        }
+    }
+    if (static_cast<std::size_t>(buf_ + N - ptr_) >= aligned_n)
+    {
+        char* r = ptr_;
+        ptr_ += aligned_n;
+        return r;
+    }
+
+    static_assert(alignment <= alignof(std::max_align_t), "you've chosen an "
+                  "alignment that is larger than alignof(std::max_align_t), and "
+                  "cannot be guaranteed by normal operator new");
+    char* r = static_cast<char*>(::operator new(n));
+    ++spills_;
+    return r;
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled>
+void
+pooled_arena<N, alignment, MaxPooled>::deallocate(char* p, std::size_t n) noexcept
+{
+    assert(pointer_in_buffer(ptr_) && "short_alloc has outlived arena");
+    if (pointer_in_buffer(p))
+    {
+        n = align_up(n);
+        if (p + n == ptr_)
+            ptr_ = p;
+        else if (n - 1 < MaxPooled)
+        {
+            node*& head = free_[n / alignment - 1];
+            node* b = ::new(p) node;
+            b->next_ = head;
+            head = b;
+        }
+    }
+    else
+        ::operator delete(p);
+}
+
+template <std::size_t N, std::size_t alignment, std::size_t MaxPooled>
+void
+pooled_arena<N, alignment, MaxPooled>::reset() noexcept
+{
+    ptr_ = buf_;
+    for (node*& head : free_)
+        head = nullptr;
+}
+
+// arena_checkpoint marks an arena or growing_arena when constructed, and
+// rolls it back to the mark when destroyed, giving back everything
+// allocated in between at once:
+//
+//   arena<4096> a;
+//   ...
+//   {
+//       arena_checkpoint<arena<4096>> cp(a);
+//       // speculative allocations from a
+//       if (accepted)
+//           cp.commit();  // keep them
+//   }                     // otherwise they are gone
+//
+// A rollback runs no destructors.  It is meant for data whose destruction
+// would only hand memory back to the arena; anything still referring to the
+// rolled back memory must not be used again (under AddressSanitizer it is
+// poisoned).  Checkpoints on one arena nest and must be rolled back in
+// reverse order.  For arena, allocations that spilled to ::operator new
+// are not tracked and are not freed by a rollback.
+
+template <class Arena>
+class arena_checkpoint
+{
+    Arena*                  a_;
+    typename Arena::marker  m_;
+
+public:
+    explicit arena_checkpoint(Arena& a) noexcept : a_(&a), m_(a.mark()) {}
+    ~arena_checkpoint() {if (a_ != nullptr) a_->rollback(m_);}
+    arena_checkpoint(const arena_checkpoint&) = delete;
+    arena_checkpoint& operator=(const arena_checkpoint&) = delete;
+
+    // Roll back now.  The mark stays and is rolled back to again on
+    // destruction.
+    void
+    rollback() noexcept
+    {
+        assert(a_ != nullptr && "arena_checkpoint already committed");
+        a_->rollback(m_);
+    }
+
+    // Keep everything allocated since the mark
+    void commit() noexcept {a_ = nullptr;}
+};
+
+template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t),
+          class Arena = arena<N, Align>>
 class short_alloc
 {
 public:
     using value_type = T;
     static auto constexpr alignment = Align;
     static auto constexpr size = N;
-    using arena_type = arena<size, alignment>;
+    using arena_type = Arena;
 
 private:
     arena_type& a_;
@@ -118,10 +580,10 @@ public:
                       "size N needs to be a multiple of alignment Align");
     }
     template <class U>
-        short_alloc(const short_alloc<U, N, alignment>& a) noexcept
+        short_alloc(const short_alloc<U, N, alignment, Arena>& a) noexcept
             : a_(a.a_) {}
 
-    template <class _Up> struct rebind {using other = short_alloc<_Up, N, alignment>;};
+    template <class _Up> struct rebind {using other = short_alloc<_Up, N, alignment, Arena>;};
 
     T* allocate(std::size_t n)
     {
@@ -132,29 +594,47 @@ public:
         a_.deallocate(reinterpret_cast<char*>(p), n*sizeof(T));
     }
 
-    template <class T1, std::size_t N1, std::size_t A1, 
-              class U, std::size_t M, std::size_t A2>
+    template <class T1, std::size_t N1, std::size_t A1, class Ar1,
+              class U, std::size_t M, std::size_t A2, class Ar2>
     friend
     bool
-    operator==(const short_alloc<T1, N1, A1>& x, const short_alloc<U, M, A2>& y) noexcept;
+    operator==(const short_alloc<T1, N1, A1, Ar1>& x,
+               const short_alloc<U, M, A2, Ar2>& y) noexcept;
 
-    template <class U, std::size_t M, std::size_t A> friend class short_alloc;
+    template <class U, std::size_t M, std::size_t A, class Ar> friend class short_alloc;
 };
 
-template <class T, std::size_t N, std::size_t A1, class U, std::size_t M, std::size_t A2>
+template <class T, std::size_t N, std::size_t A1, class Ar1,
+          class U, std::size_t M, std::size_t A2, class Ar2>
 inline
 bool
-operator==(const short_alloc<T, N, A1>& x, const short_alloc<U, M, A2>& y) noexcept
+operator==(const short_alloc<T, N, A1, Ar1>& x,
+           const short_alloc<U, M, A2, Ar2>& y) noexcept
 {
-    return N == M && A1 == A2 && &x.a_ == &y.a_;
+    return N == M && A1 == A2 &&
+           static_cast<const void*>(&x.a_) == static_cast<const void*>(&y.a_);
 }
 
-template <class T, std::size_t N, std::size_t A1, class U, std::size_t M, std::size_t A2>
+template <class T, std::size_t N, std::size_t A1, class Ar1,
+          class U, std::size_t M, std::size_t A2, class Ar2>
 inline
 bool
-operator!=(const short_alloc<T, N, A1>& x, const short_alloc<U, M, A2>& y) noexcept
+operator!=(const short_alloc<T, N, A1, Ar1>& x,
+           const short_alloc<U, M, A2, Ar2>& y) noexcept
 {
     return !(x == y);
 }
 
+// short_alloc over a growing_arena
+
+template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t),
+          class Upstream = new_delete_upstream>
+using growing_short_alloc = short_alloc<T, N, Align,
+                                        growing_arena<N, Align, Upstream>>;
+
+// short_alloc over a pooled_arena
+
+template <class T, std::size_t N, std::size_t Align = alignof(std::max_align_t)>
+using pooled_short_alloc = short_alloc<T, N, Align, pooled_arena<N, Align>>;
+
 #endif  // SHORT_ALLOC_H
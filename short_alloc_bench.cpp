@@ -0,0 +1,370 @@
+// Copyright Howard Hinnant. Distributed under the Boost
+// Software License, Version 1.0. (see http://www.boost.org/LICENSE_1_0.txt)
+
+// Benchmarks for the allocators in short_alloc.h.
+//
+// Node container workloads with erase churn run over arena and over
+// pooled_arena, both with the same buffer size.  For each run the program
+// reports ns per operation, how many allocations reached the global
+// operator new (counted by replacing it in this program), how many were
+// served from a pooled_arena free list, and how many arena bytes were
+// left in use (dead space, for arena).
+//
+// A second phase measures allocation throughput as threads are added.
+// Each thread allocates small blocks and hands most of them through a ring
+// to the next thread, which frees them, so frees are mostly remote.
+// concurrent_arena is compared with malloc and with a pooled_arena behind
+// a std::mutex.
+//
+//   c++ -std=c++14 -O2 short_alloc_bench.cpp -pthread
+//   ./a.out [operations per workload]
+
+#include "short_alloc.h"
+#include "concurrent_arena.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+std::atomic<std::size_t> heap_allocations(0);
+
+}  // unnamed namespace
+
+// GCC takes the malloc/free pairing below for a mismatched new/delete
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void*
+operator new(std::size_t n)
+{
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n == 0 ? 1 : n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {std::free(p);}
+void operator delete(void* p, std::size_t) noexcept {std::free(p);}
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+const std::size_t arena_size = 64 * 1024;
+
+typedef arena<arena_size>        plain_arena;
+typedef pooled_arena<arena_size> free_list_arena;
+
+template <class T, class Arena>
+using alloc = short_alloc<T, arena_size, alignof(std::max_align_t), Arena>;
+
+struct report
+{
+    double      ns_per_op;
+    std::size_t heap;      // allocations that reached operator new
+    std::size_t used;      // arena bytes still in use afterwards
+};
+
+// Keeps the list at a fixed length while erasing from the middle and
+// appending at the end.
+
+template <class Arena>
+void
+list_churn(Arena& a, std::size_t ops)
+{
+    std::list<int, alloc<int, Arena>> l{alloc<int, Arena>(a)};
+    for (int i = 0; i < 512; ++i)
+        l.push_back(i);
+    auto it = l.begin();
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        it = l.erase(it);
+        if (it == l.end())
+            it = l.begin();
+        if (++it == l.end())
+            it = l.begin();
+        l.push_back(static_cast<int>(i));
+    }
+}
+
+// Sliding window of keys: every insert is paired with an erase of the
+// oldest key.
+
+template <class Arena>
+void
+map_churn(Arena& a, std::size_t ops)
+{
+    typedef std::pair<const int, int> value_type;
+    std::map<int, int, std::less<int>, alloc<value_type, Arena>>
+        m{std::less<int>(), alloc<value_type, Arena>(a)};
+    const int window = 512;
+    for (int i = 0; i < window; ++i)
+        m.emplace(i, i);
+    for (std::size_t i = 0; i < ops; ++i)
+    {
+        int k = static_cast<int>(i);
+        m.erase(k);
+        m.emplace(k + window, k);
+    }
+}
+
+// Grows from empty so every rehash frees the old bucket array, then erases
+// and reinserts to churn the nodes.
+
+template <class Arena>
+void
+unordered_rehash(Arena& a, std::size_t ops)
+{
+    typedef std::pair<const int, int> value_type;
+    typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                               alloc<value_type, Arena>> map_type;
+    for (std::size_t done = 0; done < ops;)
+    {
+        map_type m(0, std::hash<int>(), std::equal_to<int>(),
+                   alloc<value_type, Arena>(a));
+        for (int i = 0; i < 256; ++i, ++done)
+            m.emplace(i, i);
+        for (int i = 0; i < 256; ++i, ++done)
+        {
+            m.erase(i);
+            m.emplace(i + 256, i);
+        }
+    }
+}
+
+template <class Arena, class Workload>
+report
+measure(Arena& a, Workload w, std::size_t ops)
+{
+    std::size_t heap0 = heap_allocations.load();
+    Clock::time_point t0 = Clock::now();
+    w(a, ops);
+    Clock::time_point t1 = Clock::now();
+    report r;
+    r.ns_per_op = std::chrono::duration<double, std::nano>(t1 - t0).count() / ops;
+    r.heap = heap_allocations.load() - heap0;
+    r.used = a.used();
+    return r;
+}
+
+void
+print(const char* workload, const char* arena_name, const report& r)
+{
+    std::printf("%-18s %-14s %9.1f %10zu %10zu\n", workload, arena_name,
+                r.ns_per_op, r.heap, r.used);
+}
+
+void
+print(const char* workload, const char* arena_name, const report& r,
+      double hit_rate)
+{
+    std::printf("%-18s %-14s %9.1f %10zu %10zu %8.1f%%\n", workload,
+                arena_name, r.ns_per_op, r.heap, r.used, 100 * hit_rate);
+}
+
+template <template <class> class Workload>
+void
+compare(const char* name, std::size_t ops)
+{
+    // static: too big for the stack, and kept out of the heap counts
+    static plain_arena a;
+    print(name, "arena", measure(a, Workload<plain_arena>(), ops));
+    static free_list_arena pa;
+    report r = measure(pa, Workload<free_list_arena>(), ops);
+    print(name, "pooled_arena", r,
+          static_cast<double>(pa.reuses()) / pa.allocations());
+}
+
+template <class Arena>
+struct list_churn_t
+{
+    void operator()(Arena& a, std::size_t ops) const {list_churn(a, ops);}
+};
+
+template <class Arena>
+struct map_churn_t
+{
+    void operator()(Arena& a, std::size_t ops) const {map_churn(a, ops);}
+};
+
+template <class Arena>
+struct unordered_rehash_t
+{
+    void operator()(Arena& a, std::size_t ops) const {unordered_rehash(a, ops);}
+};
+
+// Multithreaded allocation
+
+// Single producer, single consumer ring of blocks
+
+class ring
+{
+    static const std::size_t capacity = 1024;
+
+    struct item {char* p; std::size_t n;};
+
+    alignas(64) std::atomic<std::size_t> head_;  // consumer
+    alignas(64) std::atomic<std::size_t> tail_;  // producer
+    item buf_[capacity];
+
+public:
+    ring() : head_(0), tail_(0) {}
+
+    bool
+    push(char* p, std::size_t n)
+    {
+        std::size_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_.load(std::memory_order_acquire) == capacity)
+            return false;
+        buf_[t % capacity] = item{p, n};
+        tail_.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool
+    pop(char*& p, std::size_t& n)
+    {
+        std::size_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_.load(std::memory_order_acquire))
+            return false;
+        p = buf_[h % capacity].p;
+        n = buf_[h % capacity].n;
+        head_.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+struct malloc_heap
+{
+    template <std::size_t> char* allocate(std::size_t n)
+        {return static_cast<char*>(std::malloc(n));}
+    void deallocate(char* p, std::size_t) noexcept {std::free(p);}
+};
+
+template <class Arena>
+struct locked
+{
+    std::mutex mut_;
+    Arena      a_;
+
+    template <std::size_t A>
+    char*
+    allocate(std::size_t n)
+    {
+        std::lock_guard<std::mutex> _(mut_);
+        return a_.template allocate<A>(n);
+    }
+
+    void
+    deallocate(char* p, std::size_t n) noexcept
+    {
+        std::lock_guard<std::mutex> _(mut_);
+        a_.deallocate(p, n);
+    }
+};
+
+// Returns millions of allocate/deallocate pairs per second
+
+template <class Heap>
+double
+scaling(Heap& h, unsigned threads, std::size_t ops_per_thread)
+{
+    std::vector<ring> rings(threads);
+    std::atomic<unsigned> ready(0);
+    std::vector<std::thread> th;
+    Clock::time_point t0;
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        th.emplace_back([&, t]
+        {
+            ring& out = rings[(t + 1) % threads];
+            ring& in = rings[t];
+            ready.fetch_add(1);
+            while (ready.load() < threads)
+                std::this_thread::yield();
+            std::uint32_t x = 2463534242u + t;
+            for (std::size_t i = 0; i < ops_per_thread; ++i)
+            {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                std::size_t n = 16 + x % 241;
+                char* p = h.template allocate<alignof(std::max_align_t)>(n);
+                p[0] = 1;
+                // one in eight stays with this thread
+                if ((x & 7) == 0 || !out.push(p, n))
+                    h.deallocate(p, n);
+                if (in.pop(p, n))
+                    h.deallocate(p, n);
+            }
+        });
+    }
+    t0 = Clock::now();
+    for (auto& t : th)
+        t.join();
+    Clock::time_point t1 = Clock::now();
+    for (ring& r : rings)
+    {
+        char* p;
+        std::size_t n;
+        while (r.pop(p, n))
+            h.deallocate(p, n);
+    }
+    return threads * ops_per_thread /
+           std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+void
+scaling_sweep(std::size_t ops)
+{
+    unsigned hw = std::thread::hardware_concurrency();
+    if (hw == 0)
+        hw = 4;
+    std::vector<unsigned> thread_counts;
+    for (unsigned n = 1; n < hw; n *= 2)
+        thread_counts.push_back(n);
+    thread_counts.push_back(hw);
+    static concurrent_arena<16 << 20> ca;
+    static locked<pooled_arena<16 << 20>> la;
+    std::printf("\n%-28s %4s %10s\n", "allocator", "thr", "Mops/s");
+    for (unsigned t : thread_counts)
+    {
+        ca.reset();
+        std::printf("%-28s %4u %10.2f\n", "concurrent_arena", t,
+                    scaling(ca, t, ops));
+        la.a_.reset();
+        std::printf("%-28s %4u %10.2f\n", "mutex + pooled_arena", t,
+                    scaling(la, t, ops));
+        malloc_heap mh;
+        std::printf("%-28s %4u %10.2f\n", "malloc", t, scaling(mh, t, ops));
+    }
+}
+
+}  // unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::size_t ops = 200000;
+    if (argc > 1)
+        ops = std::strtoul(argv[1], nullptr, 10);
+    std::printf("%-18s %-14s %9s %10s %10s %9s\n", "workload", "arena",
+                "ns/op", "heap", "arena used", "reused");
+    compare<list_churn_t>("list churn", ops);
+    compare<map_churn_t>("map churn", ops);
+    compare<unordered_rehash_t>("unordered rehash", ops);
+    scaling_sweep(ops * 5);
+}
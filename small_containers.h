@@ -0,0 +1,1057 @@
+#ifndef SMALL_CONTAINERS_H
+#define SMALL_CONTAINERS_H
+
+// The MIT License (MIT)
+// 
+// Copyright (c) 2015 Howard Hinnant
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Containers with their first N elements stored inside the object:
+//
+//   small_vector<T, N>
+//   small_basic_string<CharT, N>    (small_string<N>, small_wstring<N>)
+//   small_flat_map<Key, T, N>
+//
+// Unlike short_alloc, there is no separate arena to declare and no
+// allocator reference to carry.  A container only goes to the heap when
+// it grows past N elements, and returns to its inline buffer on
+// shrink_to_fit() once it fits again.  Moving a container that is on the
+// heap steals its buffer.  Moving one that is inline relocates the
+// elements, using memcpy when is_trivially_relocatable says that is safe.
+//
+// is_trivially_relocatable<T> defaults to std::is_trivially_copyable<T>.
+// Specialize it for types that can be moved by memcpy without running
+// constructors or destructors (most types that own heap memory through a
+// pointer, std::unique_ptr for instance).
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+template <class T>
+struct is_trivially_relocatable
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value> {};
+
+template <class T, class D>
+struct is_trivially_relocatable<std::unique_ptr<T, D>>
+    : is_trivially_relocatable<D> {};
+
+template <class T1, class T2>
+struct is_trivially_relocatable<std::pair<T1, T2>>
+    : std::integral_constant<bool, is_trivially_relocatable<T1>::value &&
+                                   is_trivially_relocatable<T2>::value> {};
+
+// small_vector
+
+template <class T, std::size_t N>
+class small_vector
+{
+    static_assert(N > 0, "small_vector needs room for at least one element");
+
+public:
+    typedef T                                     value_type;
+    typedef std::size_t                           size_type;
+    typedef std::ptrdiff_t                        difference_type;
+    typedef T&                                    reference;
+    typedef const T&                              const_reference;
+    typedef T*                                    pointer;
+    typedef const T*                              const_pointer;
+    typedef T*                                    iterator;
+    typedef const T*                              const_iterator;
+    typedef std::reverse_iterator<iterator>       reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    static constexpr size_type inline_capacity = N;
+
+private:
+    T*        begin_;
+    size_type size_;
+    size_type capacity_;
+    alignas(T) unsigned char buf_[N * sizeof(T)];
+
+public:
+    small_vector() noexcept
+        : begin_(inline_data()), size_(0), capacity_(N) {}
+    explicit small_vector(size_type n)
+        : small_vector() {resize(n);}
+    small_vector(size_type n, const T& x)
+        : small_vector() {resize(n, x);}
+    template <class InputIterator,
+              class = typename std::iterator_traits<InputIterator>::iterator_category>
+        small_vector(InputIterator first, InputIterator last)
+            : small_vector() {insert(end(), first, last);}
+    small_vector(std::initializer_list<T> il)
+        : small_vector() {insert(end(), il.begin(), il.end());}
+    small_vector(const small_vector& v);
+    small_vector(small_vector&& v)
+        noexcept(std::is_nothrow_move_constructible<T>::value);
+    ~small_vector();
+
+    small_vector& operator=(const small_vector& v);
+    small_vector& operator=(small_vector&& v)
+        noexcept(std::is_nothrow_move_constructible<T>::value);
+    small_vector& operator=(std::initializer_list<T> il)
+        {assign(il.begin(), il.end()); return *this;}
+
+    template <class InputIterator,
+              class = typename std::iterator_traits<InputIterator>::iterator_category>
+        void assign(InputIterator first, InputIterator last)
+            {clear(); insert(end(), first, last);}
+    void assign(size_type n, const T& x) {clear(); resize(n, x);}
+
+    iterator               begin()         noexcept {return begin_;}
+    const_iterator         begin()   const noexcept {return begin_;}
+    iterator               end()           noexcept {return begin_ + size_;}
+    const_iterator         end()     const noexcept {return begin_ + size_;}
+    const_iterator         cbegin()  const noexcept {return begin();}
+    const_iterator         cend()    const noexcept {return end();}
+    reverse_iterator       rbegin()        noexcept {return reverse_iterator(end());}
+    const_reverse_iterator rbegin()  const noexcept {return const_reverse_iterator(end());}
+    reverse_iterator       rend()          noexcept {return reverse_iterator(begin());}
+    const_reverse_iterator rend()    const noexcept {return const_reverse_iterator(begin());}
+
+    size_type size()     const noexcept {return size_;}
+    size_type capacity() const noexcept {return capacity_;}
+    bool      empty()    const noexcept {return size_ == 0;}
+    size_type max_size() const noexcept {return size_type(~0) / sizeof(T);}
+    // true while the elements are in the inline buffer
+    bool      is_inline() const noexcept {return begin_ == inline_data();}
+
+    reference       operator[](size_type i)       noexcept {return begin_[i];}
+    const_reference operator[](size_type i) const noexcept {return begin_[i];}
+    reference       at(size_type i);
+    const_reference at(size_type i) const;
+    reference       front()       noexcept {return begin_[0];}
+    const_reference front() const noexcept {return begin_[0];}
+    reference       back()        noexcept {return begin_[size_-1];}
+    const_reference back()  const noexcept {return begin_[size_-1];}
+    T*              data()        noexcept {return begin_;}
+    const T*        data()  const noexcept {return begin_;}
+
+    void reserve(size_type n);
+    void shrink_to_fit();
+    void resize(size_type n);
+    void resize(size_type n, const T& x);
+    void clear() noexcept {destroy(begin_, begin_ + size_); size_ = 0;}
+
+    void push_back(const T& x) {emplace_back(x);}
+    void push_back(T&& x) {emplace_back(std::move(x));}
+    template <class... Args> reference emplace_back(Args&&... args);
+    void pop_back() noexcept {(begin_ + --size_)->~T();}
+
+    template <class... Args> iterator emplace(const_iterator pos, Args&&... args);
+    iterator insert(const_iterator pos, const T& x) {return emplace(pos, x);}
+    iterator insert(const_iterator pos, T&& x) {return emplace(pos, std::move(x));}
+    template <class InputIterator,
+              class = typename std::iterator_traits<InputIterator>::iterator_category>
+        iterator insert(const_iterator pos, InputIterator first, InputIterator last);
+    iterator insert(const_iterator pos, std::initializer_list<T> il)
+        {return insert(pos, il.begin(), il.end());}
+    iterator erase(const_iterator pos) {return erase(pos, pos + 1);}
+    iterator erase(const_iterator first, const_iterator last);
+
+    void swap(small_vector& v)
+        noexcept(std::is_nothrow_move_constructible<T>::value);
+
+private:
+    T* inline_data() noexcept {return reinterpret_cast<T*>(buf_);}
+    const T* inline_data() const noexcept {return reinterpret_cast<const T*>(buf_);}
+
+    static T* allocate(size_type n);
+    static void deallocate(T* p) noexcept;
+    static void destroy(T* first, T* last) noexcept;
+    static void relocate(T* first, T* last, T* result);
+    void take(small_vector& v)
+        noexcept(std::is_nothrow_move_constructible<T>::value);
+    void reallocate(size_type n);
+};
+
+template <class T, std::size_t N>
+T*
+small_vector<T, N>::allocate(size_type n)
+{
+    if (n > size_type(~0) / sizeof(T))
+        throw std::bad_alloc();
+#ifdef __cpp_aligned_new
+    if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return static_cast<T*>(::operator new(n * sizeof(T),
+                                              std::align_val_t(alignof(T))));
+#endif
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::deallocate(T* p) noexcept
+{
+#ifdef __cpp_aligned_new
+    if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        ::operator delete(p, std::align_val_t(alignof(T)));
+        return;
+    }
+#endif
+    ::operator delete(p);
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::destroy(T* first, T* last) noexcept
+{
+    for (; first != last; ++first)
+        first->~T();
+}
+
+// Moves [first, last) to the uninitialized memory at result and ends the
+// lifetime of the source.  If a copy constructor throws, the source is left
+// as it was.
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::relocate(T* first, T* last, T* result)
+{
+    if (is_trivially_relocatable<T>::value)
+    {
+        if (first != last)
+            std::memcpy(static_cast<void*>(result), static_cast<void*>(first),
+                        static_cast<std::size_t>(last - first) * sizeof(T));
+        return;
+    }
+    T* r = result;
+    try
+    {
+        for (T* p = first; p != last; ++p, ++r)
+            ::new(static_cast<void*>(r)) T(std::move_if_noexcept(*p));
+    }
+    catch (...)
+    {
+        destroy(result, r);
+        throw;
+    }
+    destroy(first, last);
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::reallocate(size_type n)
+{
+    T* p = n <= N ? inline_data() : allocate(n);
+    try
+    {
+        relocate(begin_, begin_ + size_, p);
+    }
+    catch (...)
+    {
+        if (p != inline_data())
+            deallocate(p);
+        throw;
+    }
+    if (!is_inline())
+        deallocate(begin_);
+    begin_ = p;
+    capacity_ = n <= N ? N : n;
+}
+
+template <class T, std::size_t N>
+small_vector<T, N>::small_vector(const small_vector& v)
+    : small_vector()
+{
+    reserve(v.size_);
+    std::uninitialized_copy(v.begin(), v.end(), begin_);
+    size_ = v.size_;
+}
+
+template <class T, std::size_t N>
+small_vector<T, N>::small_vector(small_vector&& v)
+    noexcept(std::is_nothrow_move_constructible<T>::value)
+    : small_vector()
+{
+    take(v);
+}
+
+// Takes the contents of v, leaving it empty, into *this, which must be
+// empty.  v's heap buffer is stolen; inline elements are relocated into
+// whatever buffer *this has, which is never smaller than N.
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::take(small_vector& v)
+    noexcept(std::is_nothrow_move_constructible<T>::value)
+{
+    if (!v.is_inline())
+    {
+        if (!is_inline())
+            deallocate(begin_);
+        begin_ = v.begin_;
+        capacity_ = v.capacity_;
+        v.begin_ = v.inline_data();
+        v.capacity_ = N;
+    }
+    else
+        relocate(v.begin_, v.begin_ + v.size_, begin_);
+    size_ = v.size_;
+    v.size_ = 0;
+}
+
+template <class T, std::size_t N>
+small_vector<T, N>::~small_vector()
+{
+    clear();
+    if (!is_inline())
+        deallocate(begin_);
+}
+
+template <class T, std::size_t N>
+small_vector<T, N>&
+small_vector<T, N>::operator=(const small_vector& v)
+{
+    if (this != &v)
+        assign(v.begin(), v.end());
+    return *this;
+}
+
+template <class T, std::size_t N>
+small_vector<T, N>&
+small_vector<T, N>::operator=(small_vector&& v)
+    noexcept(std::is_nothrow_move_constructible<T>::value)
+{
+    if (this != &v)
+    {
+        clear();
+        take(v);
+    }
+    return *this;
+}
+
+template <class T, std::size_t N>
+typename small_vector<T, N>::reference
+small_vector<T, N>::at(size_type i)
+{
+    if (i >= size_)
+        throw std::out_of_range("small_vector::at");
+    return begin_[i];
+}
+
+template <class T, std::size_t N>
+typename small_vector<T, N>::const_reference
+small_vector<T, N>::at(size_type i) const
+{
+    if (i >= size_)
+        throw std::out_of_range("small_vector::at");
+    return begin_[i];
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::reserve(size_type n)
+{
+    if (n > capacity_)
+        reallocate(n);
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::shrink_to_fit()
+{
+    if (!is_inline() && size_ < capacity_)
+        reallocate(size_);
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::resize(size_type n)
+{
+    if (n < size_)
+    {
+        destroy(begin_ + n, begin_ + size_);
+        size_ = n;
+        return;
+    }
+    reserve(n);
+    for (; size_ < n; ++size_)
+        ::new(static_cast<void*>(begin_ + size_)) T();
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::resize(size_type n, const T& x)
+{
+    if (n < size_)
+    {
+        destroy(begin_ + n, begin_ + size_);
+        size_ = n;
+        return;
+    }
+    if (n > capacity_)
+    {
+        // x may be an element
+        small_vector tmp;
+        tmp.reserve(n);
+        std::uninitialized_copy(begin(), end(), tmp.begin_);
+        tmp.size_ = size_;
+        for (; tmp.size_ < n; ++tmp.size_)
+            ::new(static_cast<void*>(tmp.begin_ + tmp.size_)) T(x);
+        swap(tmp);
+        return;
+    }
+    for (; size_ < n; ++size_)
+        ::new(static_cast<void*>(begin_ + size_)) T(x);
+}
+
+template <class T, std::size_t N>
+template <class... Args>
+typename small_vector<T, N>::reference
+small_vector<T, N>::emplace_back(Args&&... args)
+{
+    if (size_ < capacity_)
+    {
+        ::new(static_cast<void*>(begin_ + size_)) T(std::forward<Args>(args)...);
+        return begin_[size_++];
+    }
+    // Construct the new element before relocating, since args may refer
+    // to an element.
+    size_type n = 2 * capacity_;
+    T* p = allocate(n);
+    try
+    {
+        ::new(static_cast<void*>(p + size_)) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+        deallocate(p);
+        throw;
+    }
+    try
+    {
+        relocate(begin_, begin_ + size_, p);
+    }
+    catch (...)
+    {
+        (p + size_)->~T();
+        deallocate(p);
+        throw;
+    }
+    if (!is_inline())
+        deallocate(begin_);
+    begin_ = p;
+    capacity_ = n;
+    return begin_[size_++];
+}
+
+template <class T, std::size_t N>
+template <class... Args>
+typename small_vector<T, N>::iterator
+small_vector<T, N>::emplace(const_iterator pos, Args&&... args)
+{
+    size_type i = static_cast<size_type>(pos - begin_);
+    emplace_back(std::forward<Args>(args)...);
+    std::rotate(begin_ + i, begin_ + size_ - 1, begin_ + size_);
+    return begin_ + i;
+}
+
+template <class T, std::size_t N>
+template <class InputIterator, class>
+typename small_vector<T, N>::iterator
+small_vector<T, N>::insert(const_iterator pos, InputIterator first,
+                           InputIterator last)
+{
+    size_type i = static_cast<size_type>(pos - begin_);
+    size_type old_size = size_;
+    try
+    {
+        for (; first != last; ++first)
+            emplace_back(*first);
+    }
+    catch (...)
+    {
+        destroy(begin_ + old_size, begin_ + size_);
+        size_ = old_size;
+        throw;
+    }
+    std::rotate(begin_ + i, begin_ + old_size, begin_ + size_);
+    return begin_ + i;
+}
+
+template <class T, std::size_t N>
+typename small_vector<T, N>::iterator
+small_vector<T, N>::erase(const_iterator first, const_iterator last)
+{
+    T* f = begin_ + (first - begin_);
+    T* l = begin_ + (last - begin_);
+    if (f != l)
+    {
+        T* e = std::move(l, end(), f);
+        destroy(e, end());
+        size_ -= static_cast<size_type>(l - f);
+    }
+    return f;
+}
+
+template <class T, std::size_t N>
+void
+small_vector<T, N>::swap(small_vector& v)
+    noexcept(std::is_nothrow_move_constructible<T>::value)
+{
+    if (this == &v)
+        return;
+    small_vector tmp(std::move(v));
+    v = std::move(*this);
+    *this = std::move(tmp);
+}
+
+template <class T, std::size_t N>
+inline
+void
+swap(small_vector<T, N>& x, small_vector<T, N>& y)
+    noexcept(noexcept(x.swap(y)))
+{
+    x.swap(y);
+}
+
+template <class T, std::size_t N>
+inline
+bool
+operator==(const small_vector<T, N>& x, const small_vector<T, N>& y)
+{
+    return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+}
+
+template <class T, std::size_t N>
+inline
+bool
+operator!=(const small_vector<T, N>& x, const small_vector<T, N>& y)
+{
+    return !(x == y);
+}
+
+template <class T, std::size_t N>
+inline
+bool
+operator<(const small_vector<T, N>& x, const small_vector<T, N>& y)
+{
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+}
+
+template <class T, std::size_t N>
+inline
+bool
+operator>(const small_vector<T, N>& x, const small_vector<T, N>& y)
+{
+    return y < x;
+}
+
+template <class T, std::size_t N>
+inline
+bool
+operator<=(const small_vector<T, N>& x, const small_vector<T, N>& y)
+{
+    return !(y < x);
+}
+
+template <class T, std::size_t N>
+inline
+bool
+operator>=(const small_vector<T, N>& x, const small_vector<T, N>& y)
+{
+    return !(x < y);
+}
+
+// small_basic_string
+//
+// A small_vector of N + 1 characters that always ends in a null
+// character, so up to N characters are stored inline.
+
+template <class CharT, std::size_t N, class Traits = std::char_traits<CharT>>
+class small_basic_string
+{
+    small_vector<CharT, N + 1> v_;
+
+public:
+    typedef Traits                                   traits_type;
+    typedef CharT                                    value_type;
+    typedef std::size_t                              size_type;
+    typedef std::ptrdiff_t                           difference_type;
+    typedef CharT&                                   reference;
+    typedef const CharT&                             const_reference;
+    typedef CharT*                                   iterator;
+    typedef const CharT*                             const_iterator;
+    typedef std::reverse_iterator<iterator>          reverse_iterator;
+    typedef std::reverse_iterator<const_iterator>    const_reverse_iterator;
+
+    small_basic_string() noexcept {v_.emplace_back();}
+    small_basic_string(const CharT* s)
+        {v_.emplace_back(); append(s);}
+    small_basic_string(const CharT* s, size_type n)
+        {v_.emplace_back(); append(s, n);}
+    small_basic_string(size_type n, CharT c)
+        {v_.emplace_back(); append(n, c);}
+    template <class A>
+        explicit small_basic_string(const std::basic_string<CharT, Traits, A>& s)
+            {v_.emplace_back(); append(s.data(), s.size());}
+    small_basic_string(const small_basic_string&) = default;
+    small_basic_string(small_basic_string&& s) noexcept
+        : v_(std::move(s.v_))
+        {s.v_.emplace_back();}
+    small_basic_string& operator=(const small_basic_string&) = default;
+    small_basic_string&
+    operator=(small_basic_string&& s) noexcept
+    {
+        if (this != &s)
+        {
+            v_ = std::move(s.v_);
+            s.v_.emplace_back();
+        }
+        return *this;
+    }
+    small_basic_string& operator=(const CharT* s) {clear(); return append(s);}
+
+    iterator               begin()         noexcept {return v_.begin();}
+    const_iterator         begin()   const noexcept {return v_.begin();}
+    iterator               end()           noexcept {return v_.end() - 1;}
+    const_iterator         end()     const noexcept {return v_.end() - 1;}
+    const_iterator         cbegin()  const noexcept {return begin();}
+    const_iterator         cend()    const noexcept {return end();}
+    reverse_iterator       rbegin()        noexcept {return reverse_iterator(end());}
+    const_reverse_iterator rbegin()  const noexcept {return const_reverse_iterator(end());}
+    reverse_iterator       rend()          noexcept {return reverse_iterator(begin());}
+    const_reverse_iterator rend()    const noexcept {return const_reverse_iterator(begin());}
+
+    size_type size()      const noexcept {return v_.size() - 1;}
+    size_type length()    const noexcept {return size();}
+    size_type capacity()  const noexcept {return v_.capacity() - 1;}
+    bool      empty()     const noexcept {return size() == 0;}
+    bool      is_inline() const noexcept {return v_.is_inline();}
+
+    reference       operator[](size_type i)       noexcept {return v_[i];}
+    const_reference operator[](size_type i) const noexcept {return v_[i];}
+    reference       at(size_type i);
+    const_reference at(size_type i) const;
+    reference       front()       noexcept {return v_.front();}
+    const_reference front() const noexcept {return v_.front();}
+    reference       back()        noexcept {return v_[size()-1];}
+    const_reference back()  const noexcept {return v_[size()-1];}
+    const CharT*    data()  const noexcept {return v_.data();}
+    CharT*          data()        noexcept {return v_.data();}
+    const CharT*    c_str() const noexcept {return v_.data();}
+
+    void reserve(size_type n) {v_.reserve(n + 1);}
+    void shrink_to_fit() {v_.shrink_to_fit();}
+    void clear() noexcept {v_.resize(1); v_[0] = CharT();}
+    void resize(size_type n, CharT c = CharT());
+
+    small_basic_string& append(const CharT* s, size_type n);
+    small_basic_string& append(const CharT* s) {return append(s, Traits::length(s));}
+    small_basic_string& append(size_type n, CharT c);
+    small_basic_string& append(const small_basic_string& s)
+        {return append(s.data(), s.size());}
+    small_basic_string& operator+=(const small_basic_string& s) {return append(s);}
+    small_basic_string& operator+=(const CharT* s) {return append(s);}
+    small_basic_string& operator+=(CharT c) {push_back(c); return *this;}
+    void push_back(CharT c) {grow(size() + 1); v_.back() = c; v_.emplace_back();}
+    void pop_back() noexcept {v_.pop_back(); v_.back() = CharT();}
+
+    int compare(const CharT* s, size_type n) const noexcept;
+    int compare(const CharT* s) const noexcept {return compare(s, Traits::length(s));}
+    int compare(const small_basic_string& s) const noexcept
+        {return compare(s.data(), s.size());}
+
+    std::basic_string<CharT, Traits> str() const
+        {return std::basic_string<CharT, Traits>(data(), size());}
+#if __cplusplus >= 201703L
+    operator std::basic_string_view<CharT, Traits>() const noexcept
+        {return std::basic_string_view<CharT, Traits>(data(), size());}
+#endif
+
+    void swap(small_basic_string& s) noexcept {v_.swap(s.v_);}
+
+private:
+    void grow(size_type n);
+};
+
+// Makes room for n characters, growing geometrically
+
+template <class CharT, std::size_t N, class Traits>
+void
+small_basic_string<CharT, N, Traits>::grow(size_type n)
+{
+    if (n + 1 > v_.capacity())
+        v_.reserve(std::max(n + 1, 2 * v_.capacity()));
+}
+
+template <class CharT, std::size_t N, class Traits>
+typename small_basic_string<CharT, N, Traits>::reference
+small_basic_string<CharT, N, Traits>::at(size_type i)
+{
+    if (i >= size())
+        throw std::out_of_range("small_basic_string::at");
+    return v_[i];
+}
+
+template <class CharT, std::size_t N, class Traits>
+typename small_basic_string<CharT, N, Traits>::const_reference
+small_basic_string<CharT, N, Traits>::at(size_type i) const
+{
+    if (i >= size())
+        throw std::out_of_range("small_basic_string::at");
+    return v_[i];
+}
+
+template <class CharT, std::size_t N, class Traits>
+void
+small_basic_string<CharT, N, Traits>::resize(size_type n, CharT c)
+{
+    if (n <= size())
+    {
+        v_.resize(n + 1);
+        v_[n] = CharT();
+    }
+    else
+        append(n - size(), c);
+}
+
+template <class CharT, std::size_t N, class Traits>
+small_basic_string<CharT, N, Traits>&
+small_basic_string<CharT, N, Traits>::append(const CharT* s, size_type n)
+{
+    size_type sz = size();
+    std::less_equal<const CharT*> le;
+    if (le(data(), s) && le(s, data() + sz))
+    {
+        // s points into *this
+        size_type off = static_cast<size_type>(s - data());
+        grow(sz + n);
+        s = data() + off;
+    }
+    else
+        grow(sz + n);
+    v_.resize(sz + n + 1);
+    Traits::move(data() + sz, s, n);
+    v_[sz + n] = CharT();
+    return *this;
+}
+
+template <class CharT, std::size_t N, class Traits>
+small_basic_string<CharT, N, Traits>&
+small_basic_string<CharT, N, Traits>::append(size_type n, CharT c)
+{
+    size_type sz = size();
+    grow(sz + n);
+    v_.resize(sz + n + 1);
+    Traits::assign(data() + sz, n, c);  // over the old terminator too
+    v_[sz + n] = CharT();
+    return *this;
+}
+
+template <class CharT, std::size_t N, class Traits>
+int
+small_basic_string<CharT, N, Traits>::compare(const CharT* s, size_type n) const noexcept
+{
+    size_type sz = size();
+    int r = Traits::compare(data(), s, std::min(sz, n));
+    if (r != 0)
+        return r;
+    return sz < n ? -1 : sz > n ? 1 : 0;
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+void
+swap(small_basic_string<CharT, N, Traits>& x, small_basic_string<CharT, N, Traits>& y) noexcept
+{
+    x.swap(y);
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+bool
+operator==(const small_basic_string<CharT, N, Traits>& x,
+           const small_basic_string<CharT, N, Traits>& y) noexcept
+{
+    return x.compare(y) == 0;
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+bool
+operator==(const small_basic_string<CharT, N, Traits>& x, const CharT* y) noexcept
+{
+    return x.compare(y) == 0;
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+bool
+operator!=(const small_basic_string<CharT, N, Traits>& x,
+           const small_basic_string<CharT, N, Traits>& y) noexcept
+{
+    return !(x == y);
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+bool
+operator!=(const small_basic_string<CharT, N, Traits>& x, const CharT* y) noexcept
+{
+    return !(x == y);
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+bool
+operator<(const small_basic_string<CharT, N, Traits>& x,
+          const small_basic_string<CharT, N, Traits>& y) noexcept
+{
+    return x.compare(y) < 0;
+}
+
+template <class CharT, std::size_t N, class Traits>
+inline
+small_basic_string<CharT, N, Traits>
+operator+(small_basic_string<CharT, N, Traits> x,
+          const small_basic_string<CharT, N, Traits>& y)
+{
+    x += y;
+    return x;
+}
+
+template <std::size_t N> using small_string  = small_basic_string<char, N>;
+template <std::size_t N> using small_wstring = small_basic_string<wchar_t, N>;
+
+// small_flat_map
+//
+// A sorted small_vector of pair<Key, T>.  Lookup is a binary search;
+// insertion and erasure shift the later elements.  Iterators and
+// references are invalidated by insertion and erasure, as for a vector.
+
+template <class Key, class T, std::size_t N, class Compare = std::less<Key>>
+class small_flat_map
+{
+public:
+    typedef Key                                      key_type;
+    typedef T                                        mapped_type;
+    typedef std::pair<Key, T>                        value_type;
+    typedef Compare                                  key_compare;
+    typedef std::size_t                              size_type;
+    typedef std::ptrdiff_t                           difference_type;
+    typedef value_type&                              reference;
+    typedef const value_type&                        const_reference;
+
+private:
+    typedef small_vector<value_type, N> container_type;
+
+    container_type v_;
+    Compare        comp_;
+
+public:
+    typedef typename container_type::iterator               iterator;
+    typedef typename container_type::const_iterator         const_iterator;
+    typedef typename container_type::reverse_iterator       reverse_iterator;
+    typedef typename container_type::const_reverse_iterator const_reverse_iterator;
+
+    small_flat_map() = default;
+    explicit small_flat_map(const Compare& comp) : comp_(comp) {}
+    small_flat_map(std::initializer_list<value_type> il, const Compare& comp = Compare())
+        : comp_(comp)
+    {
+        for (const value_type& x : il)
+            insert(x);
+    }
+
+    iterator               begin()         noexcept {return v_.begin();}
+    const_iterator         begin()   const noexcept {return v_.begin();}
+    iterator               end()           noexcept {return v_.end();}
+    const_iterator         end()     const noexcept {return v_.end();}
+    const_iterator         cbegin()  const noexcept {return v_.begin();}
+    const_iterator         cend()    const noexcept {return v_.end();}
+    reverse_iterator       rbegin()        noexcept {return v_.rbegin();}
+    const_reverse_iterator rbegin()  const noexcept {return v_.rbegin();}
+    reverse_iterator       rend()          noexcept {return v_.rend();}
+    const_reverse_iterator rend()    const noexcept {return v_.rend();}
+
+    size_type size()      const noexcept {return v_.size();}
+    size_type capacity()  const noexcept {return v_.capacity();}
+    bool      empty()     const noexcept {return v_.empty();}
+    bool      is_inline() const noexcept {return v_.is_inline();}
+    void      reserve(size_type n) {v_.reserve(n);}
+    void      shrink_to_fit() {v_.shrink_to_fit();}
+    void      clear() noexcept {v_.clear();}
+    key_compare key_comp() const {return comp_;}
+
+    iterator lower_bound(const Key& k);
+    const_iterator lower_bound(const Key& k) const;
+    iterator find(const Key& k);
+    const_iterator find(const Key& k) const;
+    size_type count(const Key& k) const {return find(k) != end();}
+    bool contains(const Key& k) const {return find(k) != end();}
+
+    T& operator[](const Key& k) {return try_emplace(k).first->second;}
+    T& at(const Key& k);
+    const T& at(const Key& k) const;
+
+    std::pair<iterator, bool> insert(const value_type& x)
+        {return try_emplace(x.first, x.second);}
+    std::pair<iterator, bool> insert(value_type&& x)
+        {return try_emplace(std::move(x.first), std::move(x.second));}
+    template <class... Args>
+        std::pair<iterator, bool> emplace(Args&&... args)
+        {
+            value_type x(std::forward<Args>(args)...);
+            return insert(std::move(x));
+        }
+    template <class K, class... Args>
+        std::pair<iterator, bool> try_emplace(K&& k, Args&&... args);
+
+    iterator erase(const_iterator pos) {return v_.erase(pos);}
+    iterator erase(const_iterator first, const_iterator last)
+        {return v_.erase(first, last);}
+    size_type erase(const Key& k);
+
+    void swap(small_flat_map& m)
+    {
+        using std::swap;
+        v_.swap(m.v_);
+        swap(comp_, m.comp_);
+    }
+};
+
+template <class Key, class T, std::size_t N, class Compare>
+typename small_flat_map<Key, T, N, Compare>::iterator
+small_flat_map<Key, T, N, Compare>::lower_bound(const Key& k)
+{
+    return std::lower_bound(v_.begin(), v_.end(), k,
+                            [this](const value_type& x, const Key& y)
+                                {return comp_(x.first, y);});
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+typename small_flat_map<Key, T, N, Compare>::const_iterator
+small_flat_map<Key, T, N, Compare>::lower_bound(const Key& k) const
+{
+    return std::lower_bound(v_.begin(), v_.end(), k,
+                            [this](const value_type& x, const Key& y)
+                                {return comp_(x.first, y);});
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+typename small_flat_map<Key, T, N, Compare>::iterator
+small_flat_map<Key, T, N, Compare>::find(const Key& k)
+{
+    iterator i = lower_bound(k);
+    if (i != end() && !comp_(k, i->first))
+        return i;
+    return end();
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+typename small_flat_map<Key, T, N, Compare>::const_iterator
+small_flat_map<Key, T, N, Compare>::find(const Key& k) const
+{
+    const_iterator i = lower_bound(k);
+    if (i != end() && !comp_(k, i->first))
+        return i;
+    return end();
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+T&
+small_flat_map<Key, T, N, Compare>::at(const Key& k)
+{
+    iterator i = find(k);
+    if (i == end())
+        throw std::out_of_range("small_flat_map::at");
+    return i->second;
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+const T&
+small_flat_map<Key, T, N, Compare>::at(const Key& k) const
+{
+    const_iterator i = find(k);
+    if (i == end())
+        throw std::out_of_range("small_flat_map::at");
+    return i->second;
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+template <class K, class... Args>
+std::pair<typename small_flat_map<Key, T, N, Compare>::iterator, bool>
+small_flat_map<Key, T, N, Compare>::try_emplace(K&& k, Args&&... args)
+{
+    iterator i = lower_bound(k);
+    if (i != end() && !comp_(k, i->first))
+        return std::pair<iterator, bool>(i, false);
+    i = v_.emplace(i, std::piecewise_construct,
+                   std::forward_as_tuple(std::forward<K>(k)),
+                   std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::pair<iterator, bool>(i, true);
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+typename small_flat_map<Key, T, N, Compare>::size_type
+small_flat_map<Key, T, N, Compare>::erase(const Key& k)
+{
+    iterator i = find(k);
+    if (i == end())
+        return 0;
+    v_.erase(i);
+    return 1;
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+inline
+void
+swap(small_flat_map<Key, T, N, Compare>& x, small_flat_map<Key, T, N, Compare>& y)
+    noexcept(noexcept(x.swap(y)))
+{
+    x.swap(y);
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+inline
+bool
+operator==(const small_flat_map<Key, T, N, Compare>& x,
+           const small_flat_map<Key, T, N, Compare>& y)
+{
+    return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+}
+
+template <class Key, class T, std::size_t N, class Compare>
+inline
+bool
+operator!=(const small_flat_map<Key, T, N, Compare>& x,
+           const small_flat_map<Key, T, N, Compare>& y)
+{
+    return !(x == y);
+}
+
+#endif  // SMALL_CONTAINERS_H
@@ -1,94 +1,170 @@
-#ifndef STACK_ALLOC_H
-#define STACK_ALLOC_H
-
-#define HAS_TYPE_TRAITS 0
-
-#include <cstddef>
-
-#if HAS_TYPE_TRAITS
-#include <type_traits>
-#else
-#include <tr1/type_traits>
-#endif
-
-template <class T, std::size_t N> class stack_alloc;
-
-template <std::size_t N>
-class stack_alloc<void, N>
-{
-public:
-    typedef const void*       const_pointer;
-    typedef void              value_type;
-};
-
-template <class T, std::size_t N>
-class stack_alloc
-{
-public:
-    typedef std::size_t       size_type;
-    typedef T                 value_type;
-    typedef value_type*       pointer;
-    typedef const value_type* const_pointer;
-    typedef value_type&       reference;
-    typedef const value_type& const_reference;
-
-private:
-#if HAS_TYPE_TRAITS
-    typename std::aligned_storage<sizeof(T) * N, 16>::type buf_;
-#else
-    typename std::tr1::aligned_storage<sizeof(T) * N, 16>::type buf_;
-#endif
-    pointer ptr_;
-
-public:
-    stack_alloc() throw() : ptr_((pointer)&buf_) {}
-    stack_alloc(const stack_alloc&) throw() : ptr_((pointer)&buf_) {}
-    template <class U> stack_alloc(const stack_alloc<U, N>&) throw()
-         : ptr_((pointer)&buf_) {}
-
-    template <class U> struct rebind {typedef stack_alloc<U, N> other;};
-private:
-    stack_alloc& operator=(const stack_alloc&);
-public:
-    pointer allocate(size_type n, typename stack_alloc<void, N>::const_pointer = 0)
-    {
-        if ((pointer)&buf_ + N - ptr_ >= n)
-        {
-            pointer r = ptr_;
-            ptr_ += n;
-            return r;
-        }
-        return static_cast<pointer>(::operator new(n * sizeof(T)));
-    }
-    void deallocate(pointer p, size_type n)
-    {
-        if ((pointer)&buf_ <= p && p < (pointer)&buf_ + N)
-        {
-            if (p + n == ptr_)
-                ptr_ = p;
-        }
-        else
-            ::operator delete(p);
-    }
-    size_type max_size() const throw() {return size_type(~0) / sizeof(T);}
-
-    void destroy(T* p) {p->~T();}
-
-        void
-        construct(pointer p)
-        {
-            ::new((void*)p) T();
-        }
-
-    template <class A0>
-        void
-        construct(pointer p, const A0& a0)
-        {
-            ::new((void*)p) T(a0);
-        }
-
-    bool operator==(stack_alloc& a) const {return &buf_ == &a.buf_;}
-    bool operator!=(stack_alloc& a) const {return &buf_ != &a.buf_;}
-};
-
-#endif  // STACK_ALLOC_H
+#ifndef STACK_ALLOC_H
+#define STACK_ALLOC_H
+
+// stack_alloc<T, N> allocates from a stack_storage object big enough for N
+// objects of type T, and falls back to the heap when that is exhausted:
+//
+//   stack_alloc<int, 100>::storage_type s;
+//   std::vector<int, stack_alloc<int, 100>> v(s);
+//
+// The storage lives outside the allocator, so every copy of the allocator,
+// including the rebound copies containers make for their nodes, bucket
+// arrays and maps, draws on the same buffer.  The storage must outlive
+// every container using it.
+//
+// Memory is handed out by bumping a pointer, aligned for each request, so
+// over-aligned types are placed correctly.  Only a deallocation of the most
+// recent allocation gives memory back before reset().
+//
+// The allocator has no construct or destroy, so allocator_traits constructs
+// elements in place from any arguments.  Move assignment and swap
+// propagate the allocator, so moving a container moves its buffer
+// pointer instead of copying elements, and never reaches the heap.
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+template <std::size_t Size, std::size_t Align = alignof(std::max_align_t)>
+class stack_storage
+{
+    alignas(Align) unsigned char buf_[Size];
+    unsigned char* ptr_;
+
+public:
+    ~stack_storage() {ptr_ = nullptr;}
+    stack_storage() noexcept : ptr_(buf_) {}
+    stack_storage(const stack_storage&) = delete;
+    stack_storage& operator=(const stack_storage&) = delete;
+
+    void* allocate(std::size_t n, std::size_t align);
+    void deallocate(void* p, std::size_t n, std::size_t align) noexcept;
+
+    static constexpr std::size_t size() noexcept {return Size;}
+    std::size_t used() const noexcept {return static_cast<std::size_t>(ptr_ - buf_);}
+    void reset() noexcept {ptr_ = buf_;}
+
+    // Includes buf_ + Size, which allocate(0) returns once the buffer is full
+    bool
+    owns(const void* p) const noexcept
+    {
+        return std::uintptr_t(buf_) <= std::uintptr_t(p) &&
+               std::uintptr_t(p) <= std::uintptr_t(buf_) + Size;
+    }
+};
+
+template <std::size_t Size, std::size_t Align>
+void*
+stack_storage<Size, Align>::allocate(std::size_t n, std::size_t align)
+{
+    std::uintptr_t p = (std::uintptr_t(ptr_) + (align-1)) & ~std::uintptr_t(align-1);
+    if (p - std::uintptr_t(buf_) <= Size && Size - (p - std::uintptr_t(buf_)) >= n)
+    {
+        ptr_ = reinterpret_cast<unsigned char*>(p) + n;
+        return reinterpret_cast<void*>(p);
+    }
+#ifdef __cpp_aligned_new
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        return ::operator new(n, std::align_val_t(align));
+#else
+    if (align > alignof(std::max_align_t))
+        throw std::bad_alloc();  // no over-aligned operator new before C++17
+#endif
+    return ::operator new(n);
+}
+
+template <std::size_t Size, std::size_t Align>
+void
+stack_storage<Size, Align>::deallocate(void* p, std::size_t n,
+                                       std::size_t align) noexcept
+{
+    if (owns(p))
+    {
+        if (static_cast<unsigned char*>(p) + n == ptr_)
+            ptr_ = static_cast<unsigned char*>(p);
+        return;
+    }
+#ifdef __cpp_aligned_new
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    {
+        ::operator delete(p, std::align_val_t(align));
+        return;
+    }
+#else
+    (void)align;
+#endif
+    ::operator delete(p);
+}
+
+template <class T, std::size_t N,
+          class Storage = stack_storage<N * sizeof(T),
+                                        (alignof(T) > alignof(std::max_align_t) ?
+                                         alignof(T) : alignof(std::max_align_t))>>
+class stack_alloc
+{
+public:
+    typedef T              value_type;
+    typedef Storage        storage_type;
+
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type  propagate_on_container_move_assignment;
+    typedef std::true_type  propagate_on_container_swap;
+    typedef std::false_type is_always_equal;
+
+private:
+    storage_type* s_;
+
+public:
+    stack_alloc(storage_type& s) noexcept : s_(&s) {}
+    stack_alloc(const stack_alloc&) noexcept = default;
+    stack_alloc& operator=(const stack_alloc&) noexcept = default;
+    template <class U>
+        stack_alloc(const stack_alloc<U, N, Storage>& a) noexcept
+            : s_(a.s_) {}
+
+    template <class U> struct rebind {typedef stack_alloc<U, N, Storage> other;};
+
+    T*
+    allocate(std::size_t n)
+    {
+        if (n > max_size())
+            throw std::bad_alloc();
+        return static_cast<T*>(s_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void
+    deallocate(T* p, std::size_t n) noexcept
+    {
+        s_->deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    std::size_t max_size() const noexcept {return std::size_t(~0) / sizeof(T);}
+
+    storage_type& storage() const noexcept {return *s_;}
+
+    template <class T1, class U, std::size_t M, class S>
+    friend
+    bool
+    operator==(const stack_alloc<T1, M, S>& x, const stack_alloc<U, M, S>& y) noexcept;
+
+    template <class U, std::size_t M, class S> friend class stack_alloc;
+};
+
+template <class T, class U, std::size_t N, class S>
+inline
+bool
+operator==(const stack_alloc<T, N, S>& x, const stack_alloc<U, N, S>& y) noexcept
+{
+    return x.s_ == y.s_;
+}
+
+template <class T, class U, std::size_t N, class S>
+inline
+bool
+operator!=(const stack_alloc<T, N, S>& x, const stack_alloc<U, N, S>& y) noexcept
+{
+    return !(x == y);
+}
+
+#endif  // STACK_ALLOC_H